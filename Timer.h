@@ -29,6 +29,18 @@ t3.tick();
 do_code2();
 auto measured2 = t3.tock(); // measures time duration for do_code2
 std::cout << measured1 << ' ' << measured2;
+4)
+simple_timer::benchmark<> b(1000, 100); // 1000 samples, each timing a batch of 100 calls, after the default warm-up
+b.run("insert", [&] { tree.insert(next_key()); });
+b.report(std::cout); // min, median, p99, p99.9 and standard deviation per call, in nanoseconds
+5)
+simple_timer::latency_histogram<> h; // fixed size, never allocates
+simple_timer::timer<'n', double> t4;
+t4.tick();
+do_code();
+h.record(t4.tock()); // record each operation, then look at the distribution
+std::cout << h.percentile(0.99) << '\n';
+h.write_text(std::cout); // or write_binary, and merge() histograms from several threads
 */
 
 #ifndef _SIMPLE_TIMER__TIMER_
@@ -36,6 +48,18 @@ std::cout << measured1 << ' ' << measured2;
 
 #include<chrono>
 #include<iostream>
+#include<iomanip>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<thread>
+#include<atomic>
+#include<cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+#endif
 
 namespace simple_timer {
 
@@ -97,6 +121,12 @@ namespace simple_timer {
                 */
                 interval(const precision& _len) : len(_len) {}
 
+                /**
+                This gives the length of time as a number, in the timer's units
+                @return the length of time
+                */
+                precision count() const { return len; }
+
                 /**
                 This allows for the intervals to be printed
                 @param o an ostream
@@ -161,6 +191,420 @@ namespace simple_timer {
             timer_type == 'n' ? "ns" : // n for nanoseconds
             ""; // never happens due to SFINAE
     }
+
+    /**
+    @class tsc_clock a clock that reads the processor's time stamp counter, which costs a few nanoseconds instead of a system call
+    it is calibrated against steady_clock the first time it is used, and falls back to steady_clock on processors without one
+    it meets the standard clock requirements, so it can be given to benchmark
+    */
+    class tsc_clock {
+    public:
+        using rep = std::int64_t;
+        using period = std::nano;
+        using duration = std::chrono::nanoseconds;
+        using time_point = std::chrono::time_point<tsc_clock>;
+        static constexpr bool is_steady = true;
+
+        /**
+        This function reads the clock
+        @return the current time
+        */
+        static time_point now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            return time_point(duration(static_cast<rep>(static_cast<double>(__rdtsc()) * ns_per_tick())));
+#else
+            return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+#endif
+        }
+
+        /**
+        This function gives the calibration, measured once over about 20 milliseconds
+        @return how many nanoseconds one counter tick lasts
+        */
+        static double ns_per_tick() noexcept {
+            static const double calibrated = calibrate();
+            return calibrated;
+        }
+
+    private:
+        static double calibrate() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            const auto start = std::chrono::steady_clock::now();
+            const std::uint64_t ticks_start = __rdtsc();
+            while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20)) {}
+            const std::uint64_t ticks = __rdtsc() - ticks_start;
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            return ticks ? ns / static_cast<double>(ticks) : 1.0;
+#else
+            return 1.0;
+#endif
+        }
+    };
+
+    /**
+    This function stops the compiler from optimising away a value a benchmark computes
+    @param value the value to keep
+    */
+    template<typename T>
+    inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        const volatile char* keep = reinterpret_cast<const volatile char*>(&value);
+        (void)*keep;
+#endif
+    }
+
+    /**
+    @struct benchmark_stats the summary of one benchmark case, every time is in nanoseconds per call
+    */
+    struct benchmark_stats {
+        std::string name;
+        size_t samples = 0;
+        double min = 0, median = 0, p99 = 0, p999 = 0, mean = 0, stddev = 0;
+
+        /**
+        This function summarises samples
+        @param _name the name of the case
+        @param sample_ns the time per call of each sample, it is sorted in place
+        @return the summary
+        */
+        static benchmark_stats summarize(const std::string& _name, std::vector<double>& sample_ns) {
+            benchmark_stats stats;
+            stats.name = _name;
+            stats.samples = sample_ns.size();
+            if (sample_ns.empty()) { return stats; }
+            std::sort(sample_ns.begin(), sample_ns.end());
+            // nearest-rank percentile
+            auto percentile = [&](double p) { return sample_ns[std::min(sample_ns.size() - 1, static_cast<size_t>(std::ceil(p * sample_ns.size())) - (p > 0 ? 1 : 0))]; };
+            stats.min = sample_ns.front();
+            stats.median = percentile(0.5);
+            stats.p99 = percentile(0.99);
+            stats.p999 = percentile(0.999);
+            double sum = 0;
+            for (double v : sample_ns) { sum += v; }
+            stats.mean = sum / sample_ns.size();
+            double square = 0;
+            for (double v : sample_ns) { square += (v - stats.mean) * (v - stats.mean); }
+            stats.stddev = sample_ns.size() > 1 ? std::sqrt(square / (sample_ns.size() - 1)) : 0;
+            return stats;
+        }
+    };
+
+    /**
+    @class benchmark runs named cases repeatedly and reports the distribution of their times
+    each case is first run warm_up times untimed, then timed samples times, where each sample times a batch of calls
+    so that calls shorter than the clock's resolution can still be measured
+    @tparam clock_type the clock to read, high_resolution_clock like timer by default, or tsc_clock for lower overhead
+    */
+    template<typename clock_type = std::chrono::high_resolution_clock>
+    class benchmark {
+    private:
+        size_t samples; // timed samples per case, per thread
+        size_t batch; // calls per sample
+        size_t warm_up; // untimed calls before sampling
+        std::vector<benchmark_stats> results;
+
+        /**
+        This function takes the samples of one case on the calling thread
+        @param fn the code to time
+        @param out where the time per call of each sample goes
+        */
+        template<typename F>
+        void sample(F& fn, std::vector<double>& out) const {
+            clock_type::now(); // the first read may calibrate the clock, keep that out of the samples
+            for (size_t i = 0; i < warm_up; ++i) { fn(); }
+            out.reserve(out.size() + samples);
+            for (size_t s = 0; s < samples; ++s) {
+                const auto start = clock_type::now();
+                for (size_t i = 0; i < batch; ++i) { fn(); }
+                const auto stop = clock_type::now();
+                out.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / batch);
+            }
+        }
+
+    public:
+        /**
+        Constructor for the benchmark
+        @param _samples the number of timed samples per case
+        @param _batch the number of calls timed together in each sample
+        @param _warm_up the number of untimed calls before sampling starts
+        */
+        explicit benchmark(size_t _samples = 1000, size_t _batch = 1, size_t _warm_up = 100) :
+            samples(_samples ? _samples : 1), batch(_batch ? _batch : 1), warm_up(_warm_up) {}
+
+        /**
+        This function runs one case on the calling thread
+        @param name the name of the case
+        @param fn the code to time, called with no arguments
+        @return the summary of the case
+        */
+        template<typename F>
+        const benchmark_stats& run(const std::string& name, F fn) {
+            std::vector<double> sample_ns;
+            sample(fn, sample_ns);
+            results.push_back(benchmark_stats::summarize(name, sample_ns));
+            return results.back();
+        }
+
+        /**
+        This function runs one case on several threads at once, each sampling on its own and all samples summarised together
+        @param name the name of the case
+        @param threads the number of threads
+        @param fn the code to time, called with the index of the thread running it
+        @return the summary of the case
+        */
+        template<typename F>
+        const benchmark_stats& run_threads(const std::string& name, unsigned threads, F fn) {
+            if (threads == 0) { threads = 1; }
+            std::vector<std::vector<double>> per_thread(threads);
+            std::atomic<unsigned> ready(0);
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    auto call = [&] { fn(t); };
+                    ++ready;
+                    while (ready.load() < threads) {} // start together so the threads really contend
+                    sample(call, per_thread[t]);
+                });
+            }
+            for (auto& th : pool) { th.join(); }
+            std::vector<double> sample_ns;
+            for (auto& v : per_thread) { sample_ns.insert(sample_ns.end(), v.begin(), v.end()); }
+            results.push_back(benchmark_stats::summarize(name, sample_ns));
+            return results.back();
+        }
+
+        /**
+        This function gives every case run so far
+        @return the summaries, in the order the cases ran
+        */
+        const std::vector<benchmark_stats>& cases() const { return results; }
+
+        /**
+        This function prints a table of every case run so far, times in nanoseconds per call
+        @param o an ostream
+        */
+        void report(std::ostream& o) const {
+            o << std::left << std::setw(24) << "case" << std::right
+                << std::setw(10) << "samples" << std::setw(12) << "min" << std::setw(12) << "median"
+                << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "stddev" << '\n';
+            for (const auto& r : results) {
+                o << std::left << std::setw(24) << r.name << std::right << std::setw(10) << r.samples << std::fixed << std::setprecision(1)
+                    << std::setw(12) << r.min << std::setw(12) << r.median << std::setw(12) << r.p99
+                    << std::setw(12) << r.p999 << std::setw(12) << r.stddev << '\n';
+                o.unsetf(std::ios::floatfield);
+            }
+        }
+    };
+
+    /**
+    @class latency_histogram records how long operations take, in a fixed amount of memory and without ever allocating
+    values are kept in log-linear buckets: values below 2^sub_bucket_bits exactly, larger ones in 2^sub_bucket_bits buckets per power of two,
+    so every value is kept to within a relative error of 2^-sub_bucket_bits (about 3% by default) across the full 64-bit range
+    @tparam sub_bucket_bits how many bits of precision each power of two keeps
+    */
+    template<unsigned sub_bucket_bits = 5>
+    class latency_histogram {
+        static_assert(sub_bucket_bits >= 1 && sub_bucket_bits <= 16, "sub_bucket_bits must be between 1 and 16");
+    public:
+        static constexpr size_t sub_buckets = size_t(1) << sub_bucket_bits;
+        static constexpr size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    private:
+        std::uint64_t counts[bucket_count];
+        std::uint64_t total;
+        std::uint64_t smallest;
+        std::uint64_t largest;
+        long double sum;
+
+        // position of the highest set bit, v must not be 0
+        static unsigned highest_bit(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+            unsigned bit = 0;
+            while (v >>= 1) { ++bit; }
+            return bit;
+#endif
+        }
+
+    public:
+        /**
+        Default constructor, an empty histogram
+        */
+        latency_histogram() { reset(); }
+
+        /**
+        This function finds the bucket a value falls in
+        @param value the value
+        @return the bucket index
+        */
+        static size_t bucket_of(std::uint64_t value) {
+            if (value < sub_buckets) { return static_cast<size_t>(value); }
+            const unsigned shift = highest_bit(value) - sub_bucket_bits; // keep the sub_bucket_bits bits below the highest one
+            return (shift + 1) * sub_buckets + static_cast<size_t>((value >> shift) - sub_buckets);
+        }
+
+        /**
+        This function gives the largest value a bucket holds
+        @param bucket the bucket index
+        @return the largest value that falls in it
+        */
+        static std::uint64_t bucket_high(size_t bucket) {
+            if (bucket < sub_buckets) { return bucket; }
+            const unsigned shift = static_cast<unsigned>(bucket / sub_buckets - 1);
+            const std::uint64_t sub = bucket % sub_buckets;
+            return ((sub_buckets + sub + 1) << shift) - 1;
+        }
+
+        /**
+        This function empties the histogram
+        */
+        void reset() {
+            std::memset(counts, 0, sizeof(counts));
+            total = 0;
+            smallest = ~std::uint64_t(0);
+            largest = 0;
+            sum = 0;
+        }
+
+        /**
+        This function records a value, usually a time in nanoseconds
+        @param value the value
+        @param n how many times it happened
+        */
+        void record(std::uint64_t value, std::uint64_t n = 1) {
+            counts[bucket_of(value)] += n;
+            total += n;
+            sum += static_cast<long double>(value) * n;
+            if (value < smallest) { smallest = value; }
+            if (value > largest) { largest = value; }
+        }
+
+        /**
+        This function records a measured duration, in nanoseconds
+        @param d the duration
+        */
+        template<typename Rep, typename Period>
+        void record(std::chrono::duration<Rep, Period> d) {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+            record(static_cast<std::uint64_t>(ns > 0 ? ns : 0));
+        }
+
+        /**
+        This function records an interval measured by a nanosecond timer
+        @param measured the interval from timer<'n', precision>::tock
+        */
+        template<typename interval_type>
+        auto record(const interval_type& measured) -> decltype(measured.count(), void()) {
+            const double ns = static_cast<double>(measured.count());
+            record(static_cast<std::uint64_t>(ns > 0 ? ns + 0.5 : 0));
+        }
+
+        /**
+        This function adds the counts of another histogram, for example one filled by another thread
+        @param other the histogram to add
+        */
+        void merge(const latency_histogram& other) {
+            for (size_t i = 0; i < bucket_count; ++i) { counts[i] += other.counts[i]; }
+            total += other.total;
+            sum += other.sum;
+            if (other.smallest < smallest) { smallest = other.smallest; }
+            if (other.largest > largest) { largest = other.largest; }
+        }
+
+        /**
+        This function finds a percentile
+        @param p the fraction of values at or below the answer, from 0 to 1
+        @return the largest value of the bucket the percentile falls in, clamped to the largest value recorded
+        */
+        std::uint64_t percentile(double p) const {
+            if (total == 0) { return 0; }
+            if (p <= 0) { return smallest; }
+            std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(total)));
+            if (rank > total) { rank = total; }
+            std::uint64_t seen = 0;
+            for (size_t i = 0; i < bucket_count; ++i) {
+                seen += counts[i];
+                if (seen >= rank) { return std::min(bucket_high(i), largest); }
+            }
+            return largest;
+        }
+
+        std::uint64_t count() const { return total; }
+        std::uint64_t min() const { return total ? smallest : 0; }
+        std::uint64_t max() const { return largest; }
+        double mean() const { return total ? static_cast<double>(sum / total) : 0.0; }
+
+        /**
+        This function prints a summary line, then one "upper_bound count" line per non-empty bucket
+        @param o an ostream
+        */
+        void write_text(std::ostream& o) const {
+            o << "count=" << total << " min=" << min() << " p50=" << percentile(0.5) << " p99=" << percentile(0.99)
+                << " p99.9=" << percentile(0.999) << " max=" << max() << " mean=" << mean() << '\n';
+            for (size_t i = 0; i < bucket_count; ++i) {
+                if (counts[i]) { o << bucket_high(i) << ' ' << counts[i] << '\n'; }
+            }
+        }
+
+        /**
+        This function writes the histogram compactly: a header, then the index and count of each non-empty bucket
+        @param o an ostream opened in binary mode
+        */
+        void write_binary(std::ostream& o) const {
+            std::uint32_t used = 0;
+            for (size_t i = 0; i < bucket_count; ++i) { used += counts[i] != 0; }
+            const std::uint32_t bits = sub_bucket_bits;
+            const double total_sum = static_cast<double>(sum);
+            o.write("lathist1", 8);
+            o.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
+            o.write(reinterpret_cast<const char*>(&used), sizeof(used));
+            o.write(reinterpret_cast<const char*>(&smallest), sizeof(smallest));
+            o.write(reinterpret_cast<const char*>(&largest), sizeof(largest));
+            o.write(reinterpret_cast<const char*>(&total_sum), sizeof(total_sum));
+            for (size_t i = 0; i < bucket_count; ++i) {
+                if (counts[i]) {
+                    const std::uint32_t index = static_cast<std::uint32_t>(i);
+                    o.write(reinterpret_cast<const char*>(&index), sizeof(index));
+                    o.write(reinterpret_cast<const char*>(&counts[i]), sizeof(counts[i]));
+                }
+            }
+        }
+
+        /**
+        This function adds a histogram written by write_binary with the same sub_bucket_bits
+        @param in an istream opened in binary mode
+        @return true if it was read, false if the data was not a matching histogram
+        */
+        bool read_binary(std::istream& in) {
+            char magic[8];
+            std::uint32_t bits = 0, used = 0;
+            std::uint64_t low = 0, high = 0;
+            double total_sum = 0;
+            in.read(magic, 8);
+            in.read(reinterpret_cast<char*>(&bits), sizeof(bits));
+            in.read(reinterpret_cast<char*>(&used), sizeof(used));
+            in.read(reinterpret_cast<char*>(&low), sizeof(low));
+            in.read(reinterpret_cast<char*>(&high), sizeof(high));
+            in.read(reinterpret_cast<char*>(&total_sum), sizeof(total_sum));
+            if (!in || std::memcmp(magic, "lathist1", 8) != 0 || bits != sub_bucket_bits) { return false; }
+            for (std::uint32_t k = 0; k < used; ++k) {
+                std::uint32_t index = 0;
+                std::uint64_t n = 0;
+                in.read(reinterpret_cast<char*>(&index), sizeof(index));
+                in.read(reinterpret_cast<char*>(&n), sizeof(n));
+                if (!in || index >= bucket_count) { return false; }
+                counts[index] += n;
+                total += n;
+            }
+            sum += total_sum;
+            if (low < smallest) { smallest = low; }
+            if (high > largest) { largest = high; }
+            return true;
+        }
+    };
 }
 
 #endif
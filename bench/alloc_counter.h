@@ -0,0 +1,44 @@
+/**
+ counts every heap allocation of a benchmark program, and the bytes they really take as malloc sized them
+ it replaces the global operator new and delete, every array and sized form so none is left to the library's own
+ and mismatched with ours; include it once, from the benchmark's only source file
+ the counters are atomic, so a benchmark may allocate from several threads
+ */
+#ifndef bench_alloc_counter_h
+#define bench_alloc_counter_h
+#include<atomic>
+#include<cstddef>
+#include<cstdlib>
+#include<new>
+#include<malloc.h>
+
+static std::atomic<size_t> allocations(0); // calls to operator new so far
+static std::atomic<size_t> live_bytes(0); // heap bytes held now
+
+static void* counted_alloc(size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    live_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+    return p;
+}
+
+static void counted_free(void* p) noexcept {
+    if (p == nullptr) { return; }
+    live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+    std::free(p);
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+
+void* operator new[](size_t size) { return counted_alloc(size); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+
+void operator delete[](void* p) noexcept { counted_free(p); }
+
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+#endif /* bench_alloc_counter_h */
@@ -0,0 +1,109 @@
+/**
+ benchmark of the three balancing policies of rbt: red-black, AVL and WAVL
+ each policy builds a tree from random or sorted keys, then runs lookups and then updates (an erase and an insert each)
+ every phase is run twice with the same keys: once plain for the time per operation, once with rbt_count_stats for
+ the nodes visited per lookup, and the rotations, balance writes and fixup steps per update
+ build: g++ -std=c++17 -O2 -pthread bench/balance.cpp -o balance
+ run: ./balance [number of keys, default 1000000] [lookups and updates, default 1000000]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdlib>
+
+struct workload {
+    std::string name;
+    std::vector<std::uint64_t> build; // inserted in this order
+    std::vector<std::uint64_t> probes; // looked up, all present
+    std::vector<std::uint64_t> updates; // erased and then inserted again as a new key
+};
+
+workload make_workload(const std::string& name, size_t n, size_t ops) {
+    std::mt19937_64 gen(2024);
+    workload w;
+    w.name = name;
+    w.build.resize(n);
+    for (size_t i = 0; i < n; ++i) { w.build[i] = i * 2; } // even keys, odd ones are free for updates
+    if (name == "uniform") { std::shuffle(w.build.begin(), w.build.end(), gen); }
+    w.probes.resize(ops);
+    for (auto& p : w.probes) { p = (gen() % n) * 2; }
+    w.updates.resize(ops);
+    for (auto& u : w.updates) { u = (gen() % n) * 2; }
+    return w;
+}
+
+template<typename Tree>
+bool contains(const Tree& tree, std::uint64_t key) {
+    const auto view = tree.range(key, key + 1);
+    return view.begin() != view.end();
+}
+
+/**
+ run every phase on one tree
+ @param phase_done is called after each phase with its name, the seconds it took, and the tree
+ */
+template<typename Tree, typename Done>
+void run_phases(const workload& w, Done phase_done) {
+    Tree tree;
+    simple_timer::timer<'s', double> t;
+
+    t.tick();
+    for (auto k : w.build) { tree.insert(k); }
+    phase_done("build", t.tock().count(), w.build.size(), tree);
+
+    size_t found = 0;
+    t.tick();
+    for (auto k : w.probes) { found += contains(tree, k); }
+    phase_done("lookup", t.tock().count(), w.probes.size(), tree);
+    simple_timer::do_not_optimize(found);
+
+    std::uint64_t next_new = 1;
+    t.tick();
+    for (auto k : w.updates) {
+        tree.erase(k); // may already be gone, which costs the same walk
+        tree.insert(next_new);
+        next_new += 2;
+    }
+    phase_done("update", t.tock().count(), w.updates.size(), tree);
+}
+
+template<typename Policy>
+void run_policy(const workload& w) {
+    struct timing { double seconds; size_t ops; };
+    std::vector<timing> timings;
+    run_phases<rbt<std::uint64_t, std::less<std::uint64_t>, rbt_no_stats, Policy>>(w, [&](const char*, double seconds, size_t ops, const rbt<std::uint64_t, std::less<std::uint64_t>, rbt_no_stats, Policy>&) {
+        timings.push_back(timing{ seconds, ops });
+    });
+
+    size_t phase = 0;
+    run_phases<rbt<std::uint64_t, std::less<std::uint64_t>, rbt_count_stats, Policy>>(w, [&](const char* name, double, size_t ops, rbt<std::uint64_t, std::less<std::uint64_t>, rbt_count_stats, Policy>& tree) {
+        const rbt_stats s = tree.stats();
+        const rbt_health h = tree.health();
+        const timing& tm = timings[phase++];
+        std::cout << Policy::name() << ',' << w.name << ',' << w.build.size() << ',' << name << ',' << tm.seconds * 1e9 / tm.ops << ','
+            << s.average_visited() << ',' << h.height << ',' << h.average_depth << ',' << static_cast<double>(s.rotations) / ops << ','
+            << static_cast<double>(s.recolourings) / ops << ',' << static_cast<double>(s.fixup_iterations) / ops << '\n';
+        tree.reset_stats();
+    });
+}
+
+int main(int argc, char** argv) {
+
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t ops = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+
+    std::cout << "policy,workload,size,phase,ns_per_op,visited_per_walk,height,average_depth,rotations_per_op,balance_writes_per_op,fixup_steps_per_op\n";
+    for (const std::string name : { "uniform", "sorted" }) {
+        const workload w = make_workload(name, n, ops);
+        run_policy<rbt_red_black>(w);
+        run_policy<rbt_avl>(w);
+        run_policy<rbt_wavl>(w);
+    }
+
+    return 0;
+}
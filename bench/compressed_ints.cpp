@@ -0,0 +1,76 @@
+/**
+ benchmark of large sets of integer ids: memory per id and the cost of insert, find and iteration,
+ compressed_int_rbt against rbt<std::uint64_t> and std::set
+ the id sets are every id in a range, about nine in ten of them, and one in a hundred, inserted in random order,
+ plus every id inserted in increasing order as ids that are handed out one after another are
+ the memory column is every heap byte the container holds, divided by the number of ids
+ build: g++ -std=c++17 -O2 -pthread bench/compressed_ints.cpp -o compressed_ints
+ run: ./compressed_ints [ids, default 10000000]
+ */
+#include "../compressed_int_rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<set>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdlib>
+
+template<typename Set>
+void run_case(const char* name, const char* data, const std::vector<std::uint64_t>& ids, const std::vector<std::uint64_t>& probes) {
+    simple_timer::timer<'s', double> t;
+    const size_t bytes_before = live_bytes;
+    Set* set = new Set();
+    t.tick();
+    for (std::uint64_t id : ids) { set->insert(id); }
+    const double insert_ns = t.tock().count() * 1e9 / ids.size();
+    const double bytes_per_id = static_cast<double>(live_bytes - bytes_before) / ids.size();
+
+    size_t found = 0;
+    t.tick();
+    for (std::uint64_t p : probes) { found += set->find(p) != set->end(); }
+    const double find_ns = t.tock().count() * 1e9 / probes.size();
+
+    std::uint64_t sum = 0;
+    t.tick();
+    for (std::uint64_t id : *set) { sum += id; }
+    const double iterate_ns = t.tock().count() * 1e9 / ids.size();
+    simple_timer::do_not_optimize(found);
+    simple_timer::do_not_optimize(sum);
+    delete set;
+
+    std::cout << name << ',' << data << ',' << ids.size() << ',' << bytes_per_id << ',' << insert_ns << ',' << find_ns << ','
+        << iterate_ns << '\n';
+}
+
+void run_data(const char* data, std::vector<std::uint64_t> ids, bool shuffle, std::mt19937_64& gen) {
+    const std::uint64_t top = ids.back() + 1;
+    std::vector<std::uint64_t> probes(ids.size());
+    for (auto& p : probes) { p = gen() % top; }
+    if (shuffle) { std::shuffle(ids.begin(), ids.end(), gen); }
+    run_case<compressed_int_rbt<std::uint64_t>>("compressed_int_rbt", data, ids, probes);
+    run_case<rbt<std::uint64_t>>("rbt<uint64_t>", data, ids, probes);
+    run_case<std::set<std::uint64_t>>("std::set<uint64_t>", data, ids, probes);
+}
+
+int main(int argc, char** argv) {
+
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+    std::mt19937_64 gen(49);
+    std::cout << "container,data,ids,bytes_per_id,ns_per_insert,ns_per_find,ns_per_id_iterated\n";
+    std::vector<std::uint64_t> ids;
+    for (size_t i = 0; i < n; ++i) { ids.push_back(i); }
+    run_data("dense in order", ids, false, gen);
+    run_data("dense", ids, true, gen);
+    ids.clear();
+    for (std::uint64_t i = 0; ids.size() < n; ++i) { if (gen() % 10 != 0) { ids.push_back(i); } }
+    run_data("90% dense", ids, true, gen);
+    ids.clear();
+    for (std::uint64_t i = 0; ids.size() < n; ++i) { if (gen() % 100 == 0) { ids.push_back(i); } }
+    run_data("1% dense", ids, true, gen);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ benchmark of the disk-backed disk_set against the in-memory rbt
+ the key set is sized at 1x, 4x and 16x the page cache memory budget, so the disk_set has to page for the larger two
+ build: g++ -std=c++17 -O2 bench/disk_set.cpp -o disk_set_bench
+ run: ./disk_set_bench [memory budget in MiB, default 1] [scratch file, default disk_set_bench.dat]
+ */
+#include "../rbt.h"
+#include "../disk_set.h"
+#include "../Timer.h"
+#include<iostream>
+#include<set>
+#include<vector>
+#include<string>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+
+// insert into a set whose cache holds only a few small pages, so pages are evicted in the middle of splits,
+// then reopen the file and check every value came back, in order
+bool check_small_cache(const std::string& path) {
+    for (size_t frames : { 8ul, 32ul, 200ul }) {
+        std::remove(path.c_str());
+        std::set<std::uint64_t> expected;
+        std::mt19937_64 gen(28);
+        {
+            disk_set_options options;
+            options.page_size = 256;
+            options.memory_budget = frames * 400; // a frame costs the page and some bookkeeping
+            disk_set<std::uint64_t> set(path, options);
+            for (size_t i = 0; i < 20000; ++i) {
+                const std::uint64_t k = gen() % 100000;
+                if (set.insert(k) != expected.insert(k).second) { return false; }
+            }
+        }
+        disk_set<std::uint64_t> reopened(path);
+        if (reopened.size() != expected.size() || !std::equal(expected.begin(), expected.end(), reopened.begin())) { return false; }
+    }
+    std::remove(path.c_str());
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    const size_t budget_mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+    const std::string path = argc > 2 ? argv[2] : "disk_set_bench.dat";
+    const size_t budget = budget_mib << 20;
+    const size_t lookups = 1000;
+
+    if (!check_small_cache(path)) { std::cerr << "disk_set lost values with a small cache\n"; return 1; }
+
+    std::cout << "ratio,container,keys,insert_ns_per_op,find_ns_per_op,scan_ns_per_op,erase_ns_per_op,cache_bytes\n";
+
+    for (size_t ratio : { 1ul, 4ul, 16ul }) {
+        const size_t keys = ratio * budget / sizeof(std::uint64_t);
+        std::vector<std::uint64_t> data(keys);
+        std::mt19937_64 gen(42);
+        for (auto& k : data) { k = gen(); }
+        std::vector<std::uint64_t> probes(lookups);
+        for (auto& p : probes) { p = data[gen() % keys]; }
+
+        simple_timer::timer<'n', double> t;
+
+        {
+            std::remove(path.c_str());
+            disk_set_options options;
+            options.memory_budget = budget;
+            disk_set<std::uint64_t> set(path, options);
+
+            t.tick();
+            for (auto k : data) { set.insert(k); }
+            set.flush();
+            const double insert_ns = t.tock().count() / keys;
+
+            t.tick();
+            size_t found = 0;
+            for (auto p : probes) { found += set.find(p) != set.end(); }
+            const double find_ns = t.tock().count() / lookups;
+
+            t.tick();
+            std::uint64_t sum = 0;
+            for (auto k : set) { sum += k; }
+            const double scan_ns = t.tock().count() / keys;
+
+            t.tick();
+            for (size_t i = 0; i < lookups; ++i) { set.erase(probes[i]); }
+            const double erase_ns = t.tock().count() / lookups;
+
+            std::cout << ratio << "x,disk_set," << keys << ',' << insert_ns << ',' << find_ns << ',' << scan_ns << ',' << erase_ns << ',' << set.memory_used() << '\n';
+            if (found != lookups || sum == 0) { std::cerr << "unexpected result\n"; }
+        }
+        std::remove(path.c_str());
+
+        {
+            rbt<std::uint64_t> tree;
+
+            t.tick();
+            for (auto k : data) { tree.insert(k); }
+            const double insert_ns = t.tock().count() / keys;
+
+            t.tick();
+            size_t found = 0;
+            for (auto p : probes) { found += tree.find(p) != tree.end(); }
+            const double find_ns = t.tock().count() / lookups;
+
+            t.tick();
+            std::uint64_t sum = 0;
+            for (auto k : tree) { sum += k; }
+            const double scan_ns = t.tock().count() / keys;
+
+            t.tick();
+            for (size_t i = 0; i < lookups; ++i) { tree.erase(probes[i]); }
+            const double erase_ns = t.tock().count() / lookups;
+
+            std::cout << ratio << "x,rbt," << keys << ',' << insert_ns << ',' << find_ns << ',' << scan_ns << ',' << erase_ns << ",0\n";
+            if (found != lookups || sum == 0) { std::cerr << "unexpected result\n"; }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ benchmark of durable_rbt against a plain in-memory rbt
+ each configuration inserts the same keys, durable ones also log them with the given group size and sync batching
+ build: g++ -std=c++17 -O2 bench/durable_rbt.cpp -o durable_rbt_bench
+ run: ./durable_rbt_bench [number of inserts, default 100000] [file prefix, default durable_rbt_bench]
+ */
+#include "../rbt.h"
+#include "../durable_rbt.h"
+#include "../Timer.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<random>
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+
+int main(int argc, char** argv) {
+
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const std::string prefix = argc > 2 ? argv[2] : "durable_rbt_bench";
+
+    std::vector<std::uint64_t> keys(count);
+    std::mt19937_64 gen(7);
+    for (auto& k : keys) { k = gen(); }
+
+    simple_timer::timer<'s', double> t;
+    std::cout << "mode,group_size,sync_every,inserts,seconds,ops_per_second\n";
+
+    {
+        rbt<std::uint64_t> tree;
+        t.tick();
+        for (auto k : keys) { tree.insert(k); }
+        const double seconds = t.tock().count();
+        std::cout << "memory,-,-," << count << ',' << seconds << ',' << count / seconds << '\n';
+    }
+
+    struct config { size_t group_size; size_t sync_every; };
+    for (const config c : { config{ 1, 1 }, config{ 16, 1 }, config{ 256, 1 }, config{ 256, 16 }, config{ 256, 0 } }) {
+        std::remove((prefix + ".snapshot").c_str());
+        std::remove((prefix + ".log").c_str());
+        durable_rbt_options options;
+        options.group_size = c.group_size;
+        options.sync_every = c.sync_every;
+        options.checkpoint_every = 0; // checkpoints are timed separately below
+        {
+            durable_rbt<std::uint64_t> tree(prefix, options);
+            t.tick();
+            for (auto k : keys) { tree.insert(k); }
+            tree.commit(c.sync_every != 0);
+            const double seconds = t.tock().count();
+            std::cout << "durable," << c.group_size << ',' << c.sync_every << ',' << count << ',' << seconds << ',' << count / seconds << '\n';
+
+            t.tick();
+            tree.checkpoint();
+            std::cout << "checkpoint," << c.group_size << ',' << c.sync_every << ',' << count << ',' << t.tock().count() << ",-\n";
+        }
+        t.tick();
+        durable_rbt<std::uint64_t> recovered(prefix, options);
+        std::cout << "recover," << c.group_size << ',' << c.sync_every << ',' << recovered.size() << ',' << t.tock().count() << ",-\n";
+    }
+    std::remove((prefix + ".snapshot").c_str());
+    std::remove((prefix + ".log").c_str());
+
+    return 0;
+}
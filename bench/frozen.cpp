@@ -0,0 +1,82 @@
+/**
+ benchmark of looking up random keys in an rbt against the frozen copy freeze() makes of it
+ std::lower_bound over a sorted std::vector is the plain binary search reference
+ every size runs the same random probes, half of them present, and reports the time per lookup
+ build: g++ -std=c++17 -O2 -pthread bench/frozen.cpp -o frozen
+ run: ./frozen [sizes, default 1000,100000,1000000,10000000] [lookups per size, default 2000000]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdlib>
+
+std::vector<size_t> parse_sizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    for (size_t start = 0; start < text.size();) {
+        const size_t comma = std::min(text.find(',', start), text.size());
+        sizes.push_back(static_cast<size_t>(std::strtod(text.substr(start, comma - start).c_str(), nullptr)));
+        start = comma + 1;
+    }
+    return sizes;
+}
+
+/**
+ time one lookup function over every probe
+ @return nanoseconds per lookup
+ */
+template<typename Lookup>
+double time_lookups(const std::vector<std::uint64_t>& probes, Lookup lookup) {
+    simple_timer::timer<'s', double> t;
+    size_t found = 0;
+    t.tick();
+    for (auto p : probes) { found += lookup(p); }
+    const double seconds = t.tock().count();
+    simple_timer::do_not_optimize(found);
+    return seconds * 1e9 / probes.size();
+}
+
+int main(int argc, char** argv) {
+
+    const std::vector<size_t> sizes = parse_sizes(argc > 1 ? argv[1] : "1000,100000,1000000,10000000");
+    const size_t lookups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+
+    std::cout << "size,rbt_find_ns,frozen_find_ns,frozen_lower_bound_ns,sorted_vector_ns,freeze_ms,thaw_ms\n";
+    for (size_t n : sizes) {
+        std::mt19937_64 gen(42);
+        std::vector<std::uint64_t> keys(n);
+        for (size_t i = 0; i < n; ++i) { keys[i] = i * 2; } // even keys are present, odd ones are not
+        std::shuffle(keys.begin(), keys.end(), gen);
+        std::vector<std::uint64_t> probes(lookups);
+        for (auto& p : probes) { p = gen() % (2 * n); }
+
+        rbt<std::uint64_t> tree;
+        for (auto k : keys) { tree.insert(k); }
+        std::sort(keys.begin(), keys.end());
+
+        simple_timer::timer<'s', double> t;
+        t.tick();
+        const auto frozen = tree.freeze();
+        const double freeze_ms = t.tock().count() * 1e3;
+        t.tick();
+        const auto thawed = frozen.thaw();
+        const double thaw_ms = t.tock().count() * 1e3;
+        simple_timer::do_not_optimize(thawed.size());
+
+        const double rbt_ns = time_lookups(probes, [&](std::uint64_t p) { return tree.find(p) != tree.end(); });
+        const double frozen_ns = time_lookups(probes, [&](std::uint64_t p) { return frozen.find(p) != frozen.end(); });
+        const double lower_ns = time_lookups(probes, [&](std::uint64_t p) { return frozen.lower_bound(p) != frozen.end(); });
+        const double vector_ns = time_lookups(probes, [&](std::uint64_t p) {
+            const auto iter = std::lower_bound(keys.begin(), keys.end(), p);
+            return iter != keys.end() && *iter == p;
+        });
+
+        std::cout << n << ',' << rbt_ns << ',' << frozen_ns << ',' << lower_ns << ',' << vector_ns << ',' << freeze_ms << ',' << thaw_ms << '\n';
+    }
+
+    return 0;
+}
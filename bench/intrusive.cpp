@@ -0,0 +1,95 @@
+/**
+ benchmark of indexing objects that are already allocated, by id and by price, intrusive_rbt against rbt
+ intrusive_rbt links the objects in place through two hooks each; rbt stores a copy of every object in each index
+ the memory column is the heap taken by the two indexes, on top of the objects themselves
+ build: g++ -std=c++17 -O2 -pthread bench/intrusive.cpp -o intrusive
+ run: ./intrusive [objects, default 1000000]
+ */
+#include "../intrusive_rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdlib>
+
+struct order {
+    std::uint64_t id;
+    std::uint64_t price;
+    std::uint64_t quantity;
+    char account[40];
+    rbt_hook by_id;
+    rbt_hook by_price;
+};
+
+struct id_less { bool operator()(const order& a, const order& b) const { return a.id < b.id; } };
+struct price_less { bool operator()(const order& a, const order& b) const { return a.price < b.price || (a.price == b.price && a.id < b.id); } };
+
+template<typename ById, typename ByPrice, typename Insert, typename Erase>
+void run_case(const char* name, std::vector<order>& orders, const std::vector<size_t>& probes, Insert insert, Erase erase) {
+    simple_timer::timer<'s', double> t;
+    const size_t n = orders.size();
+    const size_t allocations_before = allocations;
+    const size_t bytes_before = live_bytes;
+    ById* ids = new ById();
+    ByPrice* prices = new ByPrice();
+
+    t.tick();
+    for (auto& o : orders) { insert(*ids, *prices, o); }
+    const double insert_ns = t.tock().count() * 1e9 / n;
+    const double allocations_per_object = static_cast<double>(allocations - allocations_before) / n;
+    const double bytes_per_object = static_cast<double>(live_bytes - bytes_before) / n;
+
+    order probe = order();
+    size_t found = 0;
+    t.tick();
+    for (size_t p : probes) {
+        probe.id = orders[p].id;
+        found += ids->find(probe) != ids->end();
+    }
+    const double find_ns = t.tock().count() * 1e9 / probes.size();
+    simple_timer::do_not_optimize(found);
+
+    t.tick();
+    for (size_t i = 0; i < n; i += 2) { erase(*ids, *prices, orders[i]); }
+    const double erase_ns = t.tock().count() * 1e9 / ((n + 1) / 2);
+
+    delete ids;
+    delete prices;
+    std::cout << name << ',' << n << ',' << sizeof(order) << ',' << bytes_per_object << ',' << allocations_per_object << ','
+        << insert_ns << ',' << find_ns << ',' << erase_ns << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 gen(46);
+    std::vector<order> orders(n);
+    for (size_t i = 0; i < n; ++i) {
+        orders[i].id = i;
+        orders[i].price = gen() % 10000;
+        orders[i].quantity = gen() % 100;
+    }
+    std::shuffle(orders.begin(), orders.end(), gen);
+    std::vector<size_t> probes(2 * n);
+    for (auto& p : probes) { p = gen() % n; }
+
+    std::cout << "container,objects,sizeof_object,index_bytes_per_object,allocations_per_object,ns_per_insert,ns_per_find,ns_per_erase\n";
+
+    using intrusive_ids = intrusive_rbt<order, &order::by_id, id_less>;
+    using intrusive_prices = intrusive_rbt<order, &order::by_price, price_less>;
+    run_case<intrusive_ids, intrusive_prices>("intrusive_rbt", orders, probes,
+        [](intrusive_ids& ids, intrusive_prices& prices, order& o) { ids.insert(o); prices.insert(o); },
+        [](intrusive_ids& ids, intrusive_prices& prices, order& o) { ids.unlink(o); prices.unlink(o); });
+
+    using copy_ids = rbt<order, id_less>;
+    using copy_prices = rbt<order, price_less>;
+    run_case<copy_ids, copy_prices>("rbt copies", orders, probes,
+        [](copy_ids& ids, copy_prices& prices, order& o) { ids.insert(o); prices.insert(o); },
+        [](copy_ids& ids, copy_prices& prices, order& o) { ids.erase(o); prices.erase(o); });
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ benchmark of iterating a whole tree of string keys, rbt against std::set
+ keys are 48 characters, too long for the small string buffer, so any copy of a value made while iterating is a heap allocation
+ every pass is also run with the allocation counter watching, a zero-copy iteration allocates nothing
+ build: g++ -std=c++17 -O2 -pthread bench/iterate_strings.cpp -o iterate_strings
+ run: ./iterate_strings [number of keys, default 1000000] [timed passes, default 20]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<set>
+#include<random>
+#include<cstdio>
+#include<cstdlib>
+
+/**
+ visit every value of a container in order, the way a range for loop does
+ @return the total length of the values, so the loop cannot be optimised away
+ */
+template<typename Container>
+size_t full_pass(const Container& c) {
+    size_t total = 0;
+    for (auto iter = c.begin(); iter != c.end(); ++iter) { total += iter->size(); }
+    return total;
+}
+
+template<typename Container>
+void run_case(const char* name, const Container& c, size_t passes) {
+    const size_t before = allocations;
+    const size_t expected = full_pass(c);
+    const size_t per_pass = allocations - before;
+
+    simple_timer::benchmark<simple_timer::tsc_clock> bench(passes, 1, 1);
+    const auto& stats = bench.run(name, [&] { simple_timer::do_not_optimize(full_pass(c)); });
+    std::cout << name << ',' << c.size() << ',' << stats.median / 1e6 << ',' << stats.median / c.size() << ',' << per_pass << ',' << expected << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t passes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+    std::mt19937_64 gen(11);
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        char buffer[49];
+        std::snprintf(buffer, sizeof(buffer), "string-key-%037llu", static_cast<unsigned long long>(gen()));
+        keys.emplace_back(buffer, 48);
+    }
+
+    rbt<std::string> tree;
+    std::set<std::string> set;
+    for (const auto& k : keys) {
+        tree.insert(k);
+        set.insert(k);
+    }
+    keys.clear();
+    keys.shrink_to_fit();
+
+    std::cout << "container,size,median_ms_per_pass,ns_per_element,allocations_per_pass,checksum\n";
+    run_case("rbt", tree, passes);
+    run_case("std::set", set, passes);
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+/**
+ benchmark suite running rbt and std::set side by side
+ it covers sorted, reverse, uniform random and Zipfian key orders, 4 and 8 byte integer keys and 32 byte string keys,
+ tree sizes given on the command line, and mixed read/write phases at several read ratios
+ every result is one machine-readable row: throughput, median and p99 latency per operation, and heap bytes per element
+ build: g++ -std=c++17 -O2 -pthread bench/rbt_vs_std.cpp -o rbt_vs_std
+ run: ./rbt_vs_std [--format=csv|json] [--sizes=1e3,1e4,...,1e8] [--ops=N] [--reads=1,0.9,0.5,0]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<set>
+#include<random>
+#include<algorithm>
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+
+/**
+ Zipfian ranks in [0, n), rank 0 the most popular, by the method of Gray et al. with skew theta
+ */
+class zipf_generator {
+private:
+    size_t n;
+    double theta, alpha, zeta_n, eta;
+    std::uniform_real_distribution<double> uniform;
+
+    static double zeta(size_t n, double theta) {
+        double sum = 0;
+        for (size_t i = 1; i <= n; ++i) { sum += 1.0 / std::pow(static_cast<double>(i), theta); }
+        return sum;
+    }
+
+public:
+    zipf_generator(size_t _n, double _theta = 0.99) : n(_n), theta(_theta), alpha(1.0 / (1.0 - _theta)), zeta_n(zeta(_n, _theta)),
+        eta((1.0 - std::pow(2.0 / _n, 1.0 - _theta)) / (1.0 - zeta(2, _theta) / zeta_n)), uniform(0.0, 1.0) {}
+
+    template<typename Gen>
+    size_t operator()(Gen& gen) {
+        const double u = uniform(gen);
+        const double uz = u * zeta_n;
+        if (uz < 1.0) { return 0; }
+        if (uz < 1.0 + std::pow(0.5, theta)) { return 1; }
+        return std::min(n - 1, static_cast<size_t>(n * std::pow(eta * u - eta + 1.0, alpha)));
+    }
+};
+
+// keys are made from 64-bit numbers that keep their order, so sorted and reverse workloads mean the same thing for every key type
+template<typename K> K make_key(std::uint64_t i);
+template<> std::uint32_t make_key<std::uint32_t>(std::uint64_t i) { return static_cast<std::uint32_t>(i); }
+template<> std::uint64_t make_key<std::uint64_t>(std::uint64_t i) { return i; }
+template<> std::string make_key<std::string>(std::uint64_t i) {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "key-%028llu", static_cast<unsigned long long>(i)); // always 32 characters
+    return std::string(buffer, 32);
+}
+
+template<typename K> const char* key_name();
+template<> const char* key_name<std::uint32_t>() { return "u32"; }
+template<> const char* key_name<std::uint64_t>() { return "u64"; }
+template<> const char* key_name<std::string>() { return "str32"; }
+
+/**
+ a uniform interface over the two containers
+ */
+template<typename K>
+struct rbt_adapter {
+    static const char* name() { return "rbt"; }
+    rbt<K> tree;
+    void insert(const K& k) { tree.insert(k); }
+    bool find(const K& k) { return tree.find(k) != tree.end(); }
+    size_t size() { return tree.size(); }
+};
+
+template<typename K>
+struct std_set_adapter {
+    static const char* name() { return "std::set"; }
+    std::set<K> tree;
+    void insert(const K& k) { tree.insert(k); }
+    bool find(const K& k) { return tree.find(k) != tree.end(); }
+    size_t size() { return tree.size(); }
+};
+
+struct row {
+    std::string key_type, workload, container, phase;
+    size_t size;
+    double read_ratio;
+    size_t ops;
+    double ops_per_sec, median_ns, p99_ns, bytes_per_element;
+};
+
+/**
+ the keys a workload inserts, as ordered numbers: 0..n-1 sorted or reversed, or n random numbers
+ */
+std::vector<std::uint64_t> workload_keys(const std::string& workload, size_t n, std::mt19937_64& gen) {
+    std::vector<std::uint64_t> keys(n);
+    for (size_t i = 0; i < n; ++i) { keys[i] = i * 2; } // even numbers, odd ones are free for the write phase
+    if (workload == "reverse") { std::reverse(keys.begin(), keys.end()); }
+    else if (workload == "uniform" || workload == "zipf") { std::shuffle(keys.begin(), keys.end(), gen); }
+    return keys;
+}
+
+template<typename K, typename Container>
+void run_case(const std::string& workload, size_t n, size_t ops, const std::vector<double>& read_ratios, std::vector<row>& out) {
+    std::mt19937_64 gen(12345);
+    const std::vector<std::uint64_t> order = workload_keys(workload, n, gen);
+    std::vector<K> keys;
+    keys.reserve(n);
+    for (auto i : order) { keys.push_back(make_key<K>(i)); }
+
+    Container c;
+    const size_t bytes_before = live_bytes;
+    // build phase: every key in workload order, timed one insert per sample and with no warm-up so each key goes in once
+    size_t next_key = 0;
+    simple_timer::benchmark<simple_timer::tsc_clock> build(n, 1, 0);
+    const auto& built = build.run("build", [&] { c.insert(keys[next_key++]); });
+    const double bytes_per_element = static_cast<double>(live_bytes - bytes_before) / c.size();
+    out.push_back(row{ key_name<K>(), workload, Container::name(), "build", n, 0.0, n, 1e9 / built.mean, built.median, built.p99, bytes_per_element });
+
+    // mixed phase: reads look up existing keys in the workload's distribution, writes insert keys not yet present
+    zipf_generator zipf(n);
+    std::uint64_t next_new = 1;
+    for (double read_ratio : read_ratios) {
+        std::bernoulli_distribution is_read(read_ratio);
+        simple_timer::benchmark<simple_timer::tsc_clock> bench(ops, 1, std::min<size_t>(ops / 10, 1000));
+        size_t found = 0;
+        const auto& stats = bench.run("mixed", [&] {
+            if (is_read(gen)) {
+                const size_t rank = workload == "zipf" ? zipf(gen) : static_cast<size_t>(gen() % n);
+                found += c.find(make_key<K>(rank * 2));
+            }
+            else {
+                c.insert(make_key<K>(next_new));
+                next_new += 2;
+            }
+        });
+        simple_timer::do_not_optimize(found);
+        out.push_back(row{ key_name<K>(), workload, Container::name(), "mixed", n, read_ratio, stats.samples, 1e9 / stats.mean, stats.median, stats.p99,
+            static_cast<double>(live_bytes - bytes_before) / c.size() });
+    }
+}
+
+void print_csv(const std::vector<row>& rows) {
+    std::cout << "key_type,workload,container,phase,size,read_ratio,ops,ops_per_sec,median_ns,p99_ns,bytes_per_element\n";
+    for (const auto& r : rows) {
+        std::cout << r.key_type << ',' << r.workload << ',' << r.container << ',' << r.phase << ',' << r.size << ',' << r.read_ratio << ','
+            << r.ops << ',' << r.ops_per_sec << ',' << r.median_ns << ',' << r.p99_ns << ',' << r.bytes_per_element << '\n';
+    }
+}
+
+void print_json(const std::vector<row>& rows) {
+    std::cout << "[\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const auto& r = rows[i];
+        std::cout << "  {\"key_type\": \"" << r.key_type << "\", \"workload\": \"" << r.workload << "\", \"container\": \"" << r.container
+            << "\", \"phase\": \"" << r.phase << "\", \"size\": " << r.size << ", \"read_ratio\": " << r.read_ratio << ", \"ops\": " << r.ops
+            << ", \"ops_per_sec\": " << r.ops_per_sec << ", \"median_ns\": " << r.median_ns << ", \"p99_ns\": " << r.p99_ns
+            << ", \"bytes_per_element\": " << r.bytes_per_element << '}' << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    std::cout << "]\n";
+}
+
+std::vector<double> parse_list(const std::string& text) {
+    std::vector<double> values;
+    size_t start = 0;
+    while (start <= text.size()) {
+        const size_t comma = std::min(text.find(',', start), text.size());
+        if (comma > start) { values.push_back(std::strtod(text.substr(start, comma - start).c_str(), nullptr)); }
+        start = comma + 1;
+    }
+    return values;
+}
+
+template<typename K>
+void run_key_type(const std::vector<size_t>& sizes, size_t ops, const std::vector<double>& reads, std::vector<row>& rows) {
+    for (const std::string workload : { "sorted", "reverse", "uniform", "zipf" }) {
+        for (size_t n : sizes) {
+            run_case<K, rbt_adapter<K>>(workload, n, ops, reads, rows);
+            run_case<K, std_set_adapter<K>>(workload, n, ops, reads, rows);
+            std::cerr << key_name<K>() << ' ' << workload << ' ' << n << " done\n";
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    std::string format = "csv";
+    std::vector<size_t> sizes{ 1000, 10000 };
+    size_t ops = 10000;
+    std::vector<double> reads{ 1.0, 0.9, 0.5, 0.0 };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--format=", 0) == 0) { format = arg.substr(9); }
+        else if (arg.rfind("--sizes=", 0) == 0) {
+            sizes.clear();
+            for (double s : parse_list(arg.substr(8))) { sizes.push_back(static_cast<size_t>(s)); }
+        }
+        else if (arg.rfind("--ops=", 0) == 0) { ops = static_cast<size_t>(std::strtod(arg.c_str() + 6, nullptr)); }
+        else if (arg.rfind("--reads=", 0) == 0) { reads = parse_list(arg.substr(8)); }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--format=csv|json] [--sizes=1e3,1e4,...] [--ops=N] [--reads=1,0.9,0.5,0]\n";
+            return 1;
+        }
+    }
+
+    std::vector<row> rows;
+    run_key_type<std::uint32_t>(sizes, ops, reads, rows);
+    run_key_type<std::uint64_t>(sizes, ops, reads, rows);
+    run_key_type<std::string>(sizes, ops, reads, rows);
+
+    if (format == "json") { print_json(rows); }
+    else { print_csv(rows); }
+
+    return 0;
+}
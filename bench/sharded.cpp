@@ -0,0 +1,113 @@
+/**
+ benchmark of one ordered set shared by many threads: throughput of a mixed workload from 1 to 64 threads,
+ sharded_rbt against one rbt behind one std::mutex
+ the set is filled with half the key space, then every thread runs the same number of operations on random keys,
+ a mix of finds, inserts and erases; inserts and erases are equal in number, so the set keeps its size
+ the read-mostly mix is 90% finds, the write-heavy mix 50%; the last column is the share of values in the largest shard
+ build: g++ -std=c++17 -O2 -pthread bench/sharded.cpp -o sharded
+ run: ./sharded [keys, default 1000000] [operations per thread, default 200000]
+ */
+#include "../sharded_rbt.h"
+#include "../Timer.h"
+#include<iostream>
+#include<vector>
+#include<random>
+#include<algorithm>
+#include<thread>
+#include<mutex>
+#include<atomic>
+#include<cstdint>
+#include<cstdlib>
+
+// the baseline: one tree, one lock
+struct locked_rbt {
+    mutable std::mutex lock;
+    rbt<std::uint64_t> tree;
+
+    bool insert(std::uint64_t value) {
+        std::lock_guard<std::mutex> locked(lock);
+        const size_t before = tree.size();
+        tree.insert(value);
+        return tree.size() != before;
+    }
+    size_t erase(std::uint64_t value) {
+        std::lock_guard<std::mutex> locked(lock);
+        return tree.erase(value);
+    }
+    bool contains(std::uint64_t value) const {
+        std::lock_guard<std::mutex> locked(lock);
+        return tree.find(value) != tree.end();
+    }
+    size_t size() const {
+        std::lock_guard<std::mutex> locked(lock);
+        return tree.size();
+    }
+    double largest_share() const { return 1.0; }
+};
+
+struct sharded : sharded_rbt<std::uint64_t> {
+    explicit sharded(size_t shard_count) : sharded_rbt<std::uint64_t>(shard_count) { }
+    double largest_share() const {
+        const std::vector<size_t> sizes = shard_sizes();
+        return static_cast<double>(*std::max_element(sizes.begin(), sizes.end())) / size();
+    }
+};
+
+template<typename Set>
+void run_case(const char* name, const char* mix, unsigned find_percent, Set& set, unsigned threads, size_t key_space, size_t ops) {
+    std::atomic<unsigned> ready(0);
+    std::atomic<size_t> hits(0);
+    std::vector<std::thread> pool;
+    simple_timer::timer<'s', double> t;
+    for (unsigned th = 0; th < threads; ++th) {
+        pool.emplace_back([&, th] {
+            std::mt19937_64 gen(50 + th);
+            size_t found = 0;
+            ++ready;
+            while (ready.load() < threads) { std::this_thread::yield(); } // start together so the threads really contend
+            for (size_t i = 0; i < ops; ++i) {
+                const std::uint64_t key = gen() % key_space;
+                const unsigned roll = gen() % 100;
+                if (roll < find_percent) { found += set.contains(key); }
+                else if (roll % 2 == 0) { found += set.insert(key); }
+                else { found += set.erase(key); }
+            }
+            hits += found;
+        });
+    }
+    while (ready.load() < threads) { std::this_thread::yield(); }
+    t.tick();
+    for (auto& th : pool) { th.join(); }
+    const double seconds = t.tock().count();
+    simple_timer::do_not_optimize(hits);
+    std::cout << name << ',' << mix << ',' << threads << ',' << threads * ops / seconds / 1e6 << ',' << set.largest_share() << '\n';
+}
+
+template<typename Set, typename Make>
+void run_mixes(const char* name, Make make, size_t keys, size_t ops) {
+    static const unsigned thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    const struct { const char* mix; unsigned find_percent; } mixes[] = { { "read-mostly", 90 }, { "write-heavy", 50 } };
+    for (const auto& m : mixes) {
+        for (unsigned threads : thread_counts) {
+            Set* set = make();
+            std::mt19937_64 gen(49);
+            while (set->size() < keys) { set->insert(gen() % (2 * keys)); }
+            run_case(name, m.mix, m.find_percent, *set, threads, 2 * keys, ops);
+            delete set;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    const size_t keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t ops = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000;
+
+    std::cout << "hardware threads " << std::thread::hardware_concurrency() << '\n';
+    std::cout << "container,mix,threads,million_ops_per_s,largest_shard_share\n";
+    run_mixes<locked_rbt>("rbt + mutex", [] { return new locked_rbt(); }, keys, ops);
+    run_mixes<sharded>("sharded_rbt 16", [] { return new sharded(16); }, keys, ops);
+    run_mixes<sharded>("sharded_rbt 64", [] { return new sharded(64); }, keys, ops);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ benchmark of the latency of every single insert and erase in a full tree, static_rbt against rbt
+ the tree is filled to capacity, then each step erases a random value and inserts a new one, so the size stays at the capacity
+ every operation is timed on its own with the time stamp counter and recorded in a histogram; the tail and the maximum are
+ what matter on a latency-critical path, and the allocation count shows static_rbt never reaches the heap
+ build: g++ -std=c++17 -O2 -pthread bench/static_rbt.cpp -o static_rbt
+ run: ./static_rbt [operations, default 2000000]
+ */
+#include "../static_rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<random>
+#include<cstdint>
+#include<cstdlib>
+
+constexpr size_t capacity = 4096;
+
+template<typename Tree>
+void run_case(const char* name, Tree& tree, size_t ops) {
+    std::mt19937_64 gen(45);
+    std::vector<std::uint64_t> present; // the values in the tree, in no order, to pick erases from
+    present.reserve(capacity);
+    while (present.size() < capacity) {
+        const std::uint64_t v = gen();
+        if (tree.find(v) == tree.end()) { tree.insert(v); present.push_back(v); }
+    }
+
+    simple_timer::latency_histogram<> insert_times, erase_times;
+    using clock = simple_timer::tsc_clock;
+    size_t timed_allocations = 0; // only those made by the timed operations
+    for (size_t i = 0; i < ops; ++i) {
+        const size_t pick = gen() % present.size();
+        const std::uint64_t fresh = gen();
+
+        const size_t allocations_before = allocations;
+        auto start = clock::now();
+        tree.erase(present[pick]);
+        auto stop = clock::now();
+        erase_times.record(stop - start);
+
+        start = clock::now();
+        tree.insert(fresh);
+        stop = clock::now();
+        insert_times.record(stop - start);
+        timed_allocations += allocations - allocations_before;
+
+        present[pick] = fresh; // a 64-bit random value is new with overwhelming odds
+    }
+
+    std::cout << name << ",insert," << capacity << ',' << ops << ',' << insert_times.percentile(0.5) << ',' << insert_times.percentile(0.99) << ','
+        << insert_times.percentile(0.999) << ',' << insert_times.max() << ',' << timed_allocations << '\n';
+    std::cout << name << ",erase," << capacity << ',' << ops << ',' << erase_times.percentile(0.5) << ',' << erase_times.percentile(0.99) << ','
+        << erase_times.percentile(0.999) << ',' << erase_times.max() << ',' << timed_allocations << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t ops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+
+    std::cout << "container,operation,capacity,ops,p50_ns,p99_ns,p999_ns,max_ns,allocations\n";
+    auto* fixed = new static_rbt<std::uint64_t, std::less<std::uint64_t>, capacity>();
+    run_case("static_rbt", *fixed, ops);
+    delete fixed;
+
+    rbt<std::uint64_t> heap;
+    run_case("rbt", heap, ops);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ benchmark of inserting and finding long string keys that share a long prefix, where every comparison is expensive
+ rbt<std::string> compares with std::string::compare, once per level (see rbt_three_way)
+ rbt with less_only, a comparator that only has operator(), walks down with one < per level and one more at the bottom
+ std::set is the reference, it also makes one < per level and one at the bottom
+ every rbt case is run again with rbt_count_stats for the comparisons per operation
+ build: g++ -std=c++17 -O2 -pthread bench/string_compare.cpp -o string_compare
+ run: ./string_compare [number of keys, default 1000000] [key length, default 64]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include<iostream>
+#include<vector>
+#include<string>
+#include<set>
+#include<random>
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+
+// the same order as std::less, but without a three-way form, so rbt falls back to pred
+struct less_only {
+    bool operator()(const std::string& a, const std::string& b) const { return a < b; }
+};
+
+template<typename Tree>
+bool contains(Tree& tree, const std::string& key) { return tree.find(key) != tree.end(); }
+
+/**
+ time inserting every key, then finding every probe (half present, half missing)
+ @return the seconds per insert and per find
+ */
+template<typename Tree>
+std::pair<double, double> run(Tree& tree, const std::vector<std::string>& keys, const std::vector<std::string>& probes) {
+    simple_timer::timer<'s', double> t;
+    t.tick();
+    for (const auto& k : keys) { tree.insert(k); }
+    const double insert_seconds = t.tock().count();
+
+    size_t found = 0;
+    t.tick();
+    for (const auto& p : probes) { found += contains(tree, p); }
+    const double find_seconds = t.tock().count();
+    simple_timer::do_not_optimize(found);
+    return { insert_seconds / keys.size(), find_seconds / probes.size() };
+}
+
+template<typename Compare>
+void run_rbt(const char* name, const std::vector<std::string>& keys, const std::vector<std::string>& probes) {
+    rbt<std::string, Compare> timed;
+    const auto ns = run(timed, keys, probes);
+
+    rbt<std::string, Compare, rbt_count_stats> counted;
+    for (const auto& k : keys) { counted.insert(k); }
+    const double insert_compares = static_cast<double>(counted.stats().comparisons) / keys.size();
+    counted.reset_stats();
+    size_t found = 0;
+    for (const auto& p : probes) { found += contains(counted, p); }
+    const double find_compares = static_cast<double>(counted.stats().comparisons) / probes.size();
+    simple_timer::do_not_optimize(found);
+
+    std::cout << name << ',' << keys.size() << ',' << keys.front().size() << ',' << rbt_three_way<std::string, Compare>::enabled << ','
+        << ns.first * 1e9 << ',' << ns.second * 1e9 << ',' << insert_compares << ',' << find_compares << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t length = std::max<size_t>(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64, 24);
+
+    // keys differ only in their last 20 characters, so each comparison reads the whole shared prefix first
+    std::mt19937_64 gen(41);
+    const std::string prefix(length - 20, 'p');
+    auto make = [&](unsigned long long n) {
+        char buffer[21];
+        std::snprintf(buffer, sizeof(buffer), "%020llu", n);
+        return prefix + buffer;
+    };
+    std::vector<std::string> keys, probes;
+    keys.reserve(count);
+    probes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned long long n = gen() >> 1;
+        keys.push_back(make(n << 1)); // even numbers are present
+        probes.push_back(make(i % 2 ? (gen() >> 1) << 1 | 1 : n << 1)); // odd numbers are missing
+    }
+    std::shuffle(probes.begin(), probes.end(), gen);
+
+    std::cout << "container,size,key_length,three_way,ns_per_insert,ns_per_find,compares_per_insert,compares_per_find\n";
+    run_rbt<std::less<std::string>>("rbt", keys, probes);
+    run_rbt<less_only>("rbt less_only", keys, probes);
+
+    std::set<std::string> set;
+    const auto ns = run(set, keys, probes);
+    std::cout << "std::set," << keys.size() << ',' << length << ",0," << ns.first * 1e9 << ',' << ns.second * 1e9 << ",,\n";
+
+    return 0;
+}
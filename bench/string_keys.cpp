@@ -0,0 +1,92 @@
+/**
+ benchmark of URL-like string keys: memory per key and lookup throughput, string_rbt against rbt<std::string> and std::set
+ the keys are made of a few hundred hosts, a handful of directory levels from a small vocabulary and a random file name,
+ so they are long (50 to 100 bytes) and share long prefixes, as crawled URLs and file paths do
+ the memory column is every heap byte the container holds, nodes, strings and arena, divided by the number of keys
+ build: g++ -std=c++17 -O2 -pthread bench/string_keys.cpp -o string_keys
+ run: ./string_keys [keys, default 1000000] [lookups, default 2000000]
+ */
+#include "../string_rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<set>
+#include<string>
+#include<random>
+#include<algorithm>
+#include<cstdlib>
+
+std::vector<std::string> make_urls(size_t n, std::mt19937_64& gen) {
+    static const char* words[] = { "news", "sport", "2024", "2025", "article", "video", "images", "static", "en-us", "products",
+        "category", "archive", "blog", "docs", "api", "v2", "users", "search", "help", "media" };
+    std::vector<std::string> hosts;
+    for (int i = 0; i < 300; ++i) { hosts.push_back("https://www." + std::string(words[gen() % 20]) + std::to_string(i) + ".example.com/"); }
+    std::vector<std::string> urls;
+    urls.reserve(n);
+    while (urls.size() < n) {
+        std::string url = hosts[gen() % hosts.size()];
+        const int depth = 1 + gen() % 4;
+        for (int d = 0; d < depth; ++d) { url += words[gen() % 20]; url += '/'; }
+        for (int c = 0; c < 12; ++c) { url += static_cast<char>('a' + gen() % 26); }
+        url += ".html";
+        urls.push_back(std::move(url));
+    }
+    return urls;
+}
+
+template<typename Set, typename Insert, typename Find>
+void run_case(const char* name, const std::vector<std::string>& keys, const std::vector<std::string>& probes, Insert insert, Find find) {
+    simple_timer::timer<'s', double> t;
+    const size_t bytes_before = live_bytes;
+    Set* set = new Set();
+    t.tick();
+    for (const auto& k : keys) { insert(*set, k); }
+    const double insert_ns = t.tock().count() * 1e9 / keys.size();
+    const double bytes_per_key = static_cast<double>(live_bytes - bytes_before) / keys.size();
+
+    size_t found = 0;
+    t.tick();
+    for (const auto& p : probes) { found += find(*set, p); }
+    const double seconds = t.tock().count();
+    simple_timer::do_not_optimize(found);
+    delete set;
+
+    std::cout << name << ',' << keys.size() << ',' << bytes_per_key << ',' << insert_ns << ',' << probes.size() / seconds / 1e6 << ','
+        << static_cast<double>(found) / probes.size() << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t lookups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+
+    std::mt19937_64 gen(48);
+    const std::vector<std::string> keys = make_urls(n, gen);
+    std::vector<std::string> probes = make_urls(lookups / 2, gen); // mostly misses
+    for (size_t i = 0; i < lookups / 2; ++i) { probes.push_back(keys[gen() % n]); }
+    std::shuffle(probes.begin(), probes.end(), gen);
+    size_t key_bytes = 0;
+    for (const auto& k : keys) { key_bytes += k.size(); }
+
+    std::cout << "average key length " << static_cast<double>(key_bytes) / n << " bytes\n";
+    std::cout << "container,keys,bytes_per_key,ns_per_insert,million_lookups_per_s,hit_rate\n";
+    run_case<string_rbt<>>("string_rbt", keys, probes,
+        [](string_rbt<>& s, const std::string& k) { s.insert(k); },
+        [](const string_rbt<>& s, const std::string& k) { return s.find(k) != s.end(); });
+
+    struct shared : string_rbt<> { shared() : string_rbt<>(true) { } };
+    run_case<shared>("string_rbt shared prefixes", keys, probes,
+        [](shared& s, const std::string& k) { s.insert(k); },
+        [](const shared& s, const std::string& k) { return s.find(k) != s.end(); });
+
+    run_case<rbt<std::string>>("rbt<std::string>", keys, probes,
+        [](rbt<std::string>& s, const std::string& k) { s.insert(k); },
+        [](const rbt<std::string>& s, const std::string& k) { return s.find(k) != s.end(); });
+
+    run_case<std::set<std::string>>("std::set<std::string>", keys, probes,
+        [](std::set<std::string>& s, const std::string& k) { s.insert(k); },
+        [](const std::set<std::string>& s, const std::string& k) { return s.find(k) != s.end(); });
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ benchmark of millions of tiny trees, the case inline nodes are for
+ every container builds one tree per slot with a few random values each, looks values up across all of them, then destroys them
+ rbt with 16 and 8 inline nodes is run against the plain rbt and std::set; the memory column is the tree objects plus their heap
+ build: g++ -std=c++17 -O2 -pthread bench/tiny_trees.cpp -o tiny_trees
+ run: ./tiny_trees [number of trees, default 1000000] [largest values per tree, default 15]
+ */
+#include "../rbt.h"
+#include "../Timer.h"
+#include "alloc_counter.h"
+#include<iostream>
+#include<vector>
+#include<set>
+#include<random>
+#include<cstdint>
+#include<cstdlib>
+
+template<typename Tree>
+void run_case(const char* name, const std::vector<std::vector<int>>& values, const std::vector<int>& probes) {
+    const size_t count = values.size();
+    simple_timer::timer<'s', double> t;
+    size_t inserted = 0;
+    for (const auto& v : values) { inserted += v.size(); }
+
+    const size_t bytes_before = live_bytes;
+    std::vector<Tree>* trees = new std::vector<Tree>(count); // built in place, never moved
+    const size_t allocations_before = allocations;
+    t.tick();
+    for (size_t i = 0; i < count; ++i) {
+        for (int v : values[i]) { (*trees)[i].insert(v); }
+    }
+    const double build_ns = t.tock().count() * 1e9 / inserted;
+    const double allocations_per_tree = static_cast<double>(allocations - allocations_before) / count;
+    const double bytes_per_tree = static_cast<double>(live_bytes - bytes_before) / count;
+
+    size_t found = 0;
+    t.tick();
+    for (size_t i = 0; i < probes.size(); ++i) {
+        Tree& tree = (*trees)[i % count];
+        found += tree.find(probes[i]) != tree.end();
+    }
+    const double find_ns = t.tock().count() * 1e9 / probes.size();
+    simple_timer::do_not_optimize(found);
+
+    t.tick();
+    delete trees;
+    const double destroy_ns = t.tock().count() * 1e9 / count;
+
+    std::cout << name << ',' << count << ',' << static_cast<double>(inserted) / count << ',' << sizeof(Tree) << ',' << bytes_per_tree << ','
+        << allocations_per_tree << ',' << build_ns << ',' << find_ns << ',' << destroy_ns << '\n';
+}
+
+int main(int argc, char** argv) {
+
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t most = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 15;
+
+    std::mt19937_64 gen(44);
+    std::vector<std::vector<int>> values(count);
+    for (auto& v : values) {
+        v.resize(1 + gen() % most);
+        for (int& x : v) { x = static_cast<int>(gen() % 64); }
+    }
+    std::vector<int> probes(4 * count);
+    for (int& p : probes) { p = static_cast<int>(gen() % 64); }
+
+    std::cout << "container,trees,values_per_tree,sizeof_tree,bytes_per_tree,allocations_per_tree,ns_per_insert,ns_per_find,ns_per_destroy\n";
+    run_case<rbt<int, std::less<int>, rbt_no_stats, rbt_red_black, 16>>("rbt inline 16", values, probes);
+    run_case<rbt<int, std::less<int>, rbt_no_stats, rbt_red_black, 8>>("rbt inline 8", values, probes);
+    run_case<rbt<int>>("rbt", values, probes);
+    run_case<std::set<int>>("std::set", values, probes);
+
+    return 0;
+}
@@ -0,0 +1,455 @@
+#ifndef compressed_int_rbt_h
+#define compressed_int_rbt_h
+#include "rbt.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ a run of up to block_size sorted integers of an compressed_int_rbt, stored as its smallest value and the gaps after it
+ the gap to each next value, less one, is bit-packed at the width of the largest such gap, so a run of consecutive values takes
+ no words at all and values one or two apart take one or two bits each
+ the fields are mutable because the block is changed in place inside the rbt: a block's base only ever moves between the values
+ of its neighbours, so the order of the blocks never changes
+ @tparam U is the unsigned type values are packed as
+ */
+template< typename U >
+struct rbt_packed_block
+{
+    static constexpr size_t block_size = 128;
+
+    mutable U base; // the smallest value
+    mutable std::unique_ptr<std::uint64_t[]> words; // the packed gaps, nullptr when width is 0
+    mutable std::uint16_t count; // values in the block, base included, at most block_size
+    mutable std::uint16_t capacity; // words allocated
+    mutable std::uint8_t width; // bits per packed gap
+
+    rbt_packed_block() : base(0), count(0), capacity(0), width(0) { }
+    rbt_packed_block(rbt_packed_block&&) = default;
+    rbt_packed_block& operator=(rbt_packed_block&&) = default;
+
+    /**
+     pack sorted, distinct values into this block
+     @param values is the values
+     @param n is how many, 1 to block_size
+     */
+    void encode(const U* values, size_t n) const;
+
+    /**
+     unpack every value of the block
+     @param out is where to write them, room for block_size values
+     */
+    void decode(U* out) const;
+
+    /**
+     @return the bytes of packed gaps the block holds
+     */
+    size_t packed_bytes() const { return capacity * sizeof(std::uint64_t); }
+};
+
+/**
+ the key of a block in the tree of blocks is its base
+ */
+template< typename U >
+struct rbt_packed_base
+{
+    U operator()(const rbt_packed_block<U>& block) const { return block.base; }
+};
+
+/**
+ an ordered set of integers kept as an rbt of compressed blocks, for hundreds of millions of mostly dense ids
+ where rbt<int> spends a whole node per value; dense data takes well under a byte per value, see rbt_packed_block
+ insert, erase and find walk the tree of blocks, then unpack, change and pack one block of at most 128 values;
+ a full block splits in two and a block that empties is removed, one that falls below a quarter full merges with the next
+ iteration unpacks one block at a time into the iterator, so its values come out of a small array
+ @tparam T is an integral type
+ @tparam balance_policy is rbt_red_black (the default), rbt_avl or rbt_wavl
+*/
+template< typename T, typename balance_policy = rbt_red_black >
+class compressed_int_rbt
+{
+    static_assert(std::is_integral<T>::value, "compressed_int_rbt holds integers");
+private:
+    using U = typename std::make_unsigned<T>::type;
+    using block = rbt_packed_block<U>;
+    using tree_type = rbt_keyed<block, rbt_packed_base<U>, std::less<U>, rbt_no_stats, balance_policy>;
+    static constexpr size_t block_size = block::block_size;
+
+    tree_type tree;
+    size_t value_count = 0;
+
+    /**
+     map a value to an unsigned one of the same order, signed values have their sign bit flipped
+     */
+    static U to_unsigned(T value) { return static_cast<U>(value) ^ (std::is_signed<T>::value ? U(1) << (sizeof(T) * 8 - 1) : U(0)); }
+    static T to_value(U packed) { return static_cast<T>(packed ^ (std::is_signed<T>::value ? U(1) << (sizeof(T) * 8 - 1) : U(0))); }
+
+    /**
+     find the block a value belongs in: the last one whose base is not larger, or the first block if the value is smaller than all
+     @param u is the value, as unsigned
+     @return the block, end() if the set is empty
+     */
+    typename tree_type::iterator block_for(U u);
+    typename tree_type::const_iterator block_for(U u) const;
+
+    /**
+     @return the position of the first value not smaller than u in n sorted values
+     */
+    static size_t position(const U* values, size_t n, U u);
+
+public:
+    /**
+     the iterator of a compressed_int_rbt, in increasing order; it holds the unpacked values of one block,
+     so copying it copies up to 128 values
+     */
+    class const_iterator
+    {
+        friend compressed_int_rbt;
+    private:
+        typename tree_type::const_iterator at; // the block being read, end() past the last value
+        typename tree_type::const_iterator stop;
+        size_t index = 0;
+        size_t count = 0;
+        U values[block_size];
+
+        const_iterator(typename tree_type::const_iterator _at, typename tree_type::const_iterator _stop, size_t _index) : at(_at), stop(_stop), index(_index)
+        {
+            if (at != stop) { at->decode(values); count = at->count; }
+        }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        const_iterator() = default;
+        T operator*() const { return to_value(values[index]); }
+        const_iterator& operator++()
+        {
+            if (++index == count) // on to the next block
+            {
+                index = 0;
+                count = 0;
+                ++at;
+                if (at != stop) { at->decode(values); count = at->count; }
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const const_iterator& other) const { return at == other.at && index == other.index; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+    using iterator = const_iterator;
+
+    compressed_int_rbt() = default;
+    compressed_int_rbt(const compressed_int_rbt&) = delete;
+    compressed_int_rbt& operator=(const compressed_int_rbt&) = delete;
+    compressed_int_rbt(compressed_int_rbt&& other) noexcept : tree(std::move(other.tree)), value_count(other.value_count) { other.value_count = 0; }
+    compressed_int_rbt& operator=(compressed_int_rbt&& other) noexcept { swap(other); return *this; }
+
+    /**
+     insert a value
+     @param value is the value to insert
+     @return true if it was inserted, false if it was already there
+     */
+    bool insert(T value);
+
+    /**
+     erase a value
+     @param value is the value to remove
+     @return the number of values removed, 0 or 1
+     */
+    size_t erase(T value);
+
+    /**
+     locate a value
+     @param value is the value to look for
+     @return its iterator, or end() if not found
+     */
+    const_iterator find(T value) const;
+
+    /**
+     find the first value not smaller than the given one
+     @param value is the value to look for
+     @return its iterator, or end() if every value is smaller
+     */
+    const_iterator lower_bound(T value) const;
+
+    const_iterator begin() const { return const_iterator(tree.begin(), tree.end(), 0); }
+    const_iterator end() const { return const_iterator(tree.end(), tree.end(), 0); }
+
+    /**
+     call a function on every value in increasing order, unpacking each block once, which is faster than the iterator
+     @param visit is called with each value
+     */
+    template< typename Visit >
+    void for_each(Visit visit) const;
+
+    /**
+     @return the number of values
+     */
+    size_t size() const { return value_count; }
+
+    /**
+     @return true if there are no values
+     */
+    bool empty() const { return value_count == 0; }
+
+    /**
+     @return the number of blocks, each is one node of the tree
+     */
+    size_t blocks() const { return tree.size(); }
+
+    /**
+     swap the values of two sets
+     @param other is the set to swap with
+     */
+    void swap(compressed_int_rbt& other)
+    {
+        tree.swap(other.tree);
+        std::swap(value_count, other.value_count);
+    }
+
+    /**
+     Check every invariant: the tree's own, blocks that are not empty or over full, values increasing within
+     and across blocks, and a count of values equal to size()
+     @param problem is set to a description of the first broken invariant
+     @return true if the set is valid
+     */
+    bool validate(std::string& problem) const;
+
+    /**
+     Check every invariant
+     @return true if the set is valid
+     */
+    bool validate() const;
+};
+
+/**
+ non-member swap function for compressed_int_rbt
+ @param set1 is the "left hand side" compressed_int_rbt
+ @param set2 is the "right hand side" compressed_int_rbt
+*/
+template< typename T, typename balance_policy >
+void swap(compressed_int_rbt<T, balance_policy>& set1, compressed_int_rbt<T, balance_policy>& set2) { set1.swap(set2); }
+
+template< typename U >
+void rbt_packed_block<U>::encode(const U* values, size_t n) const
+{
+    U widest = 0;
+    for (size_t i = 1; i < n; ++i) { widest |= values[i] - values[i - 1] - 1; } // or-ing the gaps has the same top bit as their max
+    unsigned bits = 0;
+    while (bits < sizeof(U) * 8 && (widest >> bits) != 0) { ++bits; }
+    const size_t needed = (bits * (n - 1) + 63) / 64;
+    if (needed > capacity || needed * 2 < capacity) // grow, or shrink when most of the words would be unused
+    {
+        words.reset(needed != 0 ? new std::uint64_t[needed] : nullptr);
+        capacity = static_cast<std::uint16_t>(needed);
+    }
+    for (size_t w = 0; w < needed; ++w) { words[w] = 0; }
+    for (size_t i = 1; bits != 0 && i < n; ++i)
+    {
+        const std::uint64_t gap = values[i] - values[i - 1] - 1;
+        const size_t bit = (i - 1) * bits;
+        words[bit / 64] |= gap << (bit % 64);
+        if (bit % 64 + bits > 64) { words[bit / 64 + 1] |= gap >> (64 - bit % 64); } // it runs over into the next word
+    }
+    base = values[0];
+    count = static_cast<std::uint16_t>(n);
+    width = static_cast<std::uint8_t>(bits);
+}
+
+template< typename U >
+void rbt_packed_block<U>::decode(U* out) const
+{
+    const unsigned bits = width;
+    const size_t n = count;
+    if (bits == 0) // a run of consecutive values
+    {
+        for (size_t i = 0; i < n; ++i) { out[i] = static_cast<U>(base + i); }
+        return;
+    }
+    // unpack the gaps with no dependency from one to the next, which the compiler can vectorise, then add them up
+    const std::uint64_t mask = bits == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+    out[0] = base;
+    for (size_t i = 1; i < n; ++i)
+    {
+        const size_t bit = (i - 1) * bits;
+        const size_t word = bit / 64;
+        const unsigned shift = bit % 64;
+        std::uint64_t gap = words[word] >> shift;
+        if (shift + bits > 64) { gap |= words[word + 1] << (64 - shift); }
+        out[i] = static_cast<U>((gap & mask) + 1);
+    }
+    for (size_t i = 1; i < n; ++i) { out[i] += out[i - 1]; }
+}
+
+template< typename T, typename balance_policy >
+size_t compressed_int_rbt<T, balance_policy>::position(const U* values, size_t n, U u)
+{
+    size_t first = 0;
+    while (n > 0) // a branch-free binary search over at most 128 values
+    {
+        const size_t half = n / 2;
+        first = values[first + half] < u ? first + n - half : first;
+        n = half;
+    }
+    return first;
+}
+
+template< typename T, typename balance_policy >
+typename compressed_int_rbt<T, balance_policy>::tree_type::iterator compressed_int_rbt<T, balance_policy>::block_for(U u)
+{
+    auto at = tree.lower_bound(u); // the first block whose base is not smaller
+    if (at != tree.end() && at->base == u) { return at; }
+    if (at == tree.begin()) { return at; } // smaller than every base, it goes in the first block
+    return --at;
+}
+
+template< typename T, typename balance_policy >
+typename compressed_int_rbt<T, balance_policy>::tree_type::const_iterator compressed_int_rbt<T, balance_policy>::block_for(U u) const
+{
+    auto at = tree.lower_bound(u);
+    if (at != tree.end() && at->base == u) { return at; }
+    if (at == tree.begin()) { return at; }
+    return --at;
+}
+
+template< typename T, typename balance_policy >
+bool compressed_int_rbt<T, balance_policy>::insert(T value)
+{
+    const U u = to_unsigned(value);
+    auto at = block_for(u);
+    if (at == tree.end()) // the first value
+    {
+        block first;
+        first.encode(&u, 1);
+        tree.insert(std::move(first));
+        ++value_count;
+        return true;
+    }
+    U values[block_size + 1];
+    at->decode(values);
+    size_t n = at->count;
+    const size_t i = position(values, n, u);
+    if (i < n && values[i] == u) { return false; }
+    for (size_t j = n; j > i; --j) { values[j] = values[j - 1]; }
+    values[i] = u;
+    ++n;
+    ++value_count;
+    if (n <= block_size)
+    {
+        at->encode(values, n); // the base only changes when u is below every value, in the first block
+        return true;
+    }
+    // a full block splits in half, the upper half becomes a new block after it; appending past the largest value,
+    // as ids handed out in order do, leaves the block full instead, so the set does not settle at half full blocks
+    auto next = at;
+    const size_t half = i == n - 1 && ++next == tree.end() ? block_size : n / 2;
+    at->encode(values, half);
+    block upper;
+    upper.encode(values + half, n - half);
+    tree.insert(std::move(upper));
+    return true;
+}
+
+template< typename T, typename balance_policy >
+size_t compressed_int_rbt<T, balance_policy>::erase(T value)
+{
+    const U u = to_unsigned(value);
+    auto at = block_for(u);
+    if (at == tree.end()) { return 0; }
+    U values[2 * block_size];
+    at->decode(values);
+    size_t n = at->count;
+    const size_t i = position(values, n, u);
+    if (i == n || values[i] != u) { return 0; }
+    for (size_t j = i + 1; j < n; ++j) { values[j - 1] = values[j]; }
+    --n;
+    --value_count;
+    if (n == 0) { tree.erase(at); return 1; }
+    auto next = at;
+    ++next;
+    if (n < block_size / 4 && next != tree.end() && n + next->count <= block_size) // merge a sparse block into the next one
+    {
+        next->decode(values + n);
+        n += next->count;
+        tree.erase(next);
+    }
+    at->encode(values, n); // the base only grows, and stays below the next block's values
+    return 1;
+}
+
+template< typename T, typename balance_policy >
+typename compressed_int_rbt<T, balance_policy>::const_iterator compressed_int_rbt<T, balance_policy>::find(T value) const
+{
+    const_iterator iter = lower_bound(value);
+    return iter != end() && *iter == value ? iter : end();
+}
+
+template< typename T, typename balance_policy >
+typename compressed_int_rbt<T, balance_policy>::const_iterator compressed_int_rbt<T, balance_policy>::lower_bound(T value) const
+{
+    const U u = to_unsigned(value);
+    auto at = block_for(u);
+    if (at == tree.end()) { return end(); }
+    const_iterator iter(at, tree.end(), 0);
+    iter.index = position(iter.values, iter.count, u);
+    if (iter.index == iter.count) // every value of the block is smaller, the answer is the first of the next block
+    {
+        iter.index = iter.count - 1;
+        ++iter;
+    }
+    return iter;
+}
+
+template< typename T, typename balance_policy >
+template< typename Visit >
+void compressed_int_rbt<T, balance_policy>::for_each(Visit visit) const
+{
+    U values[block_size];
+    for (const block& b : tree)
+    {
+        b.decode(values);
+        for (size_t i = 0; i < b.count; ++i) { visit(to_value(values[i])); }
+    }
+}
+
+template< typename T, typename balance_policy >
+bool compressed_int_rbt<T, balance_policy>::validate(std::string& problem) const
+{
+    if (!tree.validate(problem)) { return false; }
+    U values[block_size];
+    size_t seen = 0;
+    bool first = true;
+    U last = 0;
+    for (const block& b : tree)
+    {
+        if (b.count == 0 || b.count > block_size) { problem = "block with " + std::to_string(b.count) + " values"; return false; }
+        b.decode(values);
+        for (size_t i = 0; i < b.count; ++i)
+        {
+            if (!first && !(last < values[i])) { problem = "values out of order"; return false; }
+            last = values[i];
+            first = false;
+        }
+        seen += b.count;
+    }
+    if (seen != value_count) { problem = std::to_string(seen) + " values but size " + std::to_string(value_count); return false; }
+    return true;
+}
+
+template< typename T, typename balance_policy >
+bool compressed_int_rbt<T, balance_policy>::validate() const
+{
+    std::string problem;
+    return validate(problem);
+}
+
+#endif /* compressed_int_rbt_h */
@@ -0,0 +1,241 @@
+#ifndef const_set_h
+#define const_set_h
+#include "rbt.h"
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+#if __cplusplus < 201402L
+#error "const_set.h needs C++14 to sort its tables at compile time"
+#endif
+
+/**
+ compile-time companions of rbt for small static lookup tables, such as enum-to-name or opcode tables
+ the values are sorted and laid out in Eytzinger order (see rbt_eytzinger) by a constexpr constructor, so a table declared
+ constexpr costs nothing at startup and never allocates
+ lookups use rbt's names: find, lower_bound, begin, end, size and empty; each step of a search is index arithmetic, not a branch
+ the values must be literal types with a constexpr comparator, e.g. integers, enums or std::string_view with std::less
+
+ example:
+    constexpr auto colours = make_const_set<std::string_view>({ "red", "orange", "yellow", "green", "blue", "indigo", "violet" });
+    static_assert(colours.find("green") != colours.end(), "green is a colour");
+
+    constexpr auto opcodes = make_const_map<std::string_view, int>({ { "add", 1 }, { "sub", 2 }, { "jmp", 7 } });
+    static_assert(opcodes.at("jmp") == 7, "jmp is 7");
+ */
+
+/**
+ the key of a set value is the value itself
+ */
+template< typename T >
+struct rbt_const_identity
+{
+    static constexpr const T& key(const T& value) { return value; }
+};
+
+/**
+ one key and value of an rbt_const_map, a plain aggregate so it can be sorted at compile time
+ */
+template< typename K, typename V >
+struct rbt_const_entry
+{
+    K key;
+    V value;
+};
+
+/**
+ the key of a map entry is its key member
+ */
+template< typename K, typename V >
+struct rbt_const_entry_key
+{
+    static constexpr const K& key(const rbt_const_entry<K, V>& entry) { return entry.key; }
+};
+
+/**
+ the table shared by rbt_const_set and rbt_const_map: N values in Eytzinger order, in an array inside the object
+ @tparam Value is what is stored
+ @tparam Key is what lookups take, the part of Value that is compared
+ @tparam N is the number of values
+ @tparam compare_type is the rule to compare keys, it must be usable in constant expressions
+ @tparam key_of gives the key of a value
+ */
+template< typename Value, typename Key, std::size_t N, typename compare_type, typename key_of >
+class rbt_const_table
+{
+    static_assert(N > 0, "an rbt_const_table needs at least one value");
+protected:
+    Value values[N + 1]{}; // values[1] is the root and values[2i], values[2i + 1] are the children of values[i]; values[0] is unused
+    compare_type pred;
+
+    /**
+     the same fixed-step search as rbt::frozen, without prefetching since the tables are small
+     @return the slot of the first value whose key is not smaller than key, 0 if every key is smaller
+     */
+    constexpr std::size_t lower_bound_slot(const Key& key) const
+    {
+        std::size_t slot = 1;
+        while (slot <= N) { slot = 2 * slot + static_cast<std::size_t>(pred(key_of::key(values[slot]), key)); } // right when too small
+        return rbt_eytzinger::up_from_right(slot);
+    }
+
+public:
+    /**
+     the iterator of a table, in increasing order of keys
+     */
+    class const_iterator
+    {
+        friend rbt_const_table;
+    private:
+        const rbt_const_table* container = nullptr;
+        std::size_t slot = 0; // 0 is past the end
+        constexpr const_iterator(const rbt_const_table* _container, std::size_t _slot) : container(_container), slot(_slot) { }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        constexpr const_iterator() = default;
+        constexpr const Value& operator*() const { return container->values[slot]; }
+        constexpr const Value* operator->() const { return &container->values[slot]; }
+        constexpr const_iterator& operator++() { slot = rbt_eytzinger::next(slot, N); return *this; }
+        constexpr const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        constexpr bool operator==(const const_iterator& other) const { return slot == other.slot; }
+        constexpr bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+    };
+    using iterator = const_iterator;
+
+    /**
+     sort the values and lay them out, at compile time when the table is constexpr
+     @param input is the values, in any order
+     @param _pred is the rule to compare keys
+     @throws std::invalid_argument if two values have equivalent keys, which stops compilation of a constexpr table
+     */
+    constexpr rbt_const_table(const Value (&input)[N], const compare_type& _pred = compare_type()) : pred(_pred)
+    {
+        Value sorted[N]{};
+        for (std::size_t i = 0; i < N; ++i) // insertion sort, the tables are small and this runs once, in the compiler
+        {
+            std::size_t j = i;
+            for (; j > 0 && pred(key_of::key(input[i]), key_of::key(sorted[j - 1])); --j) { sorted[j] = sorted[j - 1]; }
+            sorted[j] = input[i];
+        }
+        for (std::size_t i = 1; i < N; ++i)
+        {
+            if (!pred(key_of::key(sorted[i - 1]), key_of::key(sorted[i]))) { throw std::invalid_argument("rbt_const_table: duplicate key"); }
+        }
+        std::size_t slot = rbt_eytzinger::first(N);
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            values[slot] = sorted[i];
+            slot = rbt_eytzinger::next(slot, N);
+        }
+    }
+
+    /**
+     @return the number of values
+     */
+    constexpr std::size_t size() const { return N; }
+
+    /**
+     @return false, a table always has values
+     */
+    constexpr bool empty() const { return false; }
+
+    /**
+     @return an iterator to the value with the smallest key
+     */
+    constexpr const_iterator begin() const { return const_iterator(this, rbt_eytzinger::first(N)); }
+
+    /**
+     @return the past-the-end iterator
+     */
+    constexpr const_iterator end() const { return const_iterator(this, 0); }
+
+    /**
+     find the first value whose key is not smaller than the given one
+     @param key is the key to look for
+     @return its iterator, or end() if every key is smaller
+     */
+    constexpr const_iterator lower_bound(const Key& key) const { return const_iterator(this, lower_bound_slot(key)); }
+
+    /**
+     find the value with the given key, the lower bound search and one more comparison
+     @param key is the key to look for
+     @return its iterator, or end() if it is not there
+     */
+    constexpr const_iterator find(const Key& key) const
+    {
+        const std::size_t slot = lower_bound_slot(key);
+        return const_iterator(this, slot != 0 && !pred(key, key_of::key(values[slot])) ? slot : 0);
+    }
+};
+
+/**
+ a compile-time ordered set of N values
+ @tparam T is the data stored
+ @tparam N is the number of values
+ @tparam compare_type is the rule to compare values
+ */
+template< typename T, std::size_t N, typename compare_type = std::less< T > >
+class rbt_const_set : public rbt_const_table< T, T, N, compare_type, rbt_const_identity<T> >
+{
+public:
+    using rbt_const_table< T, T, N, compare_type, rbt_const_identity<T> >::rbt_const_table;
+};
+
+/**
+ a compile-time ordered map of N keys to values
+ @tparam K is the key type
+ @tparam V is the mapped type
+ @tparam N is the number of entries
+ @tparam compare_type is the rule to compare keys
+ */
+template< typename K, typename V, std::size_t N, typename compare_type = std::less< K > >
+class rbt_const_map : public rbt_const_table< rbt_const_entry<K, V>, K, N, compare_type, rbt_const_entry_key<K, V> >
+{
+public:
+    using rbt_const_table< rbt_const_entry<K, V>, K, N, compare_type, rbt_const_entry_key<K, V> >::rbt_const_table;
+
+    /**
+     the value mapped to a key
+     @param key is the key to look for
+     @return the value
+     @throws std::out_of_range if the key is not in the map
+     */
+    constexpr const V& at(const K& key) const
+    {
+        const auto iter = this->find(key);
+        if (iter == this->end()) { throw std::out_of_range("rbt_const_map::at: no such key"); }
+        return iter->value;
+    }
+};
+
+/**
+ make a compile-time set, deducing its size from the values
+ @param values is the values, in any order and without duplicates
+ @param _pred is the rule to compare values
+ @return the set
+ */
+template< typename T, typename compare_type = std::less< T >, std::size_t N >
+constexpr rbt_const_set<T, N, compare_type> make_const_set(const T (&values)[N], const compare_type& _pred = compare_type())
+{
+    return rbt_const_set<T, N, compare_type>(values, _pred);
+}
+
+/**
+ make a compile-time map, deducing its size from the entries
+ @param entries is the { key, value } entries, in any order and without duplicate keys
+ @param _pred is the rule to compare keys
+ @return the map
+ */
+template< typename K, typename V, typename compare_type = std::less< K >, std::size_t N >
+constexpr rbt_const_map<K, V, N, compare_type> make_const_map(const rbt_const_entry<K, V> (&entries)[N], const compare_type& _pred = compare_type())
+{
+    return rbt_const_map<K, V, N, compare_type>(entries, _pred);
+}
+
+#endif /* const_set_h */
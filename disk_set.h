@@ -0,0 +1,632 @@
+#ifndef disk_set_h
+#define disk_set_h
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ an ordered set kept in a file, for key sets larger than memory
+ it has the same insert, find, erase and ordered iteration API as rbt, but stores its values in a page-structured B+ tree
+ only the pages in the LRU page cache are held in memory, and the cache never grows past the memory budget given in the options
+ @tparam T is the data stored in the set, it must be trivially copyable since pages are written as raw bytes
+ @tparam compare_type is the rule to compare values (of type T)
+*/
+template< typename T, typename compare_type = std::less< T > >
+class disk_set;
+
+/**
+ the tuning knobs of a disk_set
+ memory_budget is the most memory the page cache may use, in bytes, including its bookkeeping
+ write_batch is how many dirty pages are written back together when the cache has to make room
+ page_size is the size of each page in the file, at least 56 bytes for the meta page, it only applies when the file is created
+ */
+struct disk_set_options
+{
+    size_t memory_budget = size_t(64) << 20;
+    size_t write_batch = 64;
+    size_t page_size = 4096;
+};
+
+template< typename T, typename compare_type >
+class disk_set
+{
+    static_assert(std::is_trivially_copyable<T>::value, "disk_set stores values as raw bytes, so T must be trivially copyable");
+private:
+    /**
+     the layout of the first page of the file, which describes the tree
+     */
+    struct meta
+    {
+        char magic[8]; // always "rbtdisk1"
+        std::uint64_t page_size;
+        std::uint64_t value_size;
+        std::uint64_t root; // page id of the root
+        std::uint64_t first_leaf; // page id of the leftmost leaf
+        std::uint64_t page_count; // pages in the file, including this one
+        std::uint64_t size; // number of values
+    };
+
+    /**
+     one cached page: its bytes, whether they differ from the file, and how many operations are using it
+     */
+    struct frame
+    {
+        std::uint64_t id;
+        std::vector<char> data;
+        bool dirty = false;
+        int pins = 0;
+        typename std::list<frame*>::iterator lru; // position in the LRU list, front is most recent
+    };
+
+    /**
+     keeps a page pinned in the cache while it is in use, so it cannot be evicted underneath us
+     */
+    class pinned;
+
+    /**
+     what a child reports to its parent after an insert: whether it split, and if so the separator and the new right page
+     */
+    struct split_result
+    {
+        bool inserted = false;
+        bool split = false;
+        T separator;
+        std::uint64_t right = 0;
+    };
+
+    // every page starts with a 16 byte header: a leaf flag, the number of values, and (for leaves) the next leaf
+    static constexpr size_t header_size = 16;
+    static constexpr std::uint64_t no_page = 0; // page 0 holds the meta data, so it is never a tree page
+
+    int fd = -1;
+    compare_type pred;
+    disk_set_options options;
+    meta info;
+    size_t leaf_capacity; // values per leaf page
+    size_t inner_capacity; // separators per inner page, it has one more child than that
+    size_t max_frames; // how many pages fit in the memory budget
+    std::unordered_map<std::uint64_t, frame*> frames;
+    std::list<frame*> lru;
+
+    // reading and writing the fields of a page, through memcpy since the page bytes have no alignment guarantee
+    static bool is_leaf(const frame* f) { std::uint32_t v; std::memcpy(&v, f->data.data(), 4); return v != 0; }
+    static void set_leaf(frame* f, bool leaf) { const std::uint32_t v = leaf; std::memcpy(f->data.data(), &v, 4); }
+    static size_t count_of(const frame* f) { std::uint32_t v; std::memcpy(&v, f->data.data() + 4, 4); return v; }
+    static void set_count(frame* f, size_t n) { const std::uint32_t v = static_cast<std::uint32_t>(n); std::memcpy(f->data.data() + 4, &v, 4); }
+    static std::uint64_t next_of(const frame* f) { std::uint64_t v; std::memcpy(&v, f->data.data() + 8, 8); return v; }
+    static void set_next(frame* f, std::uint64_t v) { std::memcpy(f->data.data() + 8, &v, 8); }
+    static T key_at(const frame* f, size_t i) { T v; std::memcpy(&v, f->data.data() + header_size + i * sizeof(T), sizeof(T)); return v; }
+    static void set_key(frame* f, size_t i, const T& v) { std::memcpy(f->data.data() + header_size + i * sizeof(T), &v, sizeof(T)); }
+    std::uint64_t child_at(const frame* f, size_t i) const { std::uint64_t v; std::memcpy(&v, f->data.data() + header_size + inner_capacity * sizeof(T) + i * 8, 8); return v; }
+    void set_child(frame* f, size_t i, std::uint64_t v) { std::memcpy(f->data.data() + header_size + inner_capacity * sizeof(T) + i * 8, &v, 8); }
+
+    /**
+     the memory one cached page costs: its bytes plus the frame, the map entry and the list entry
+     */
+    size_t frame_cost() const { return info.page_size + sizeof(frame) + 4 * sizeof(void*) + sizeof(std::uint64_t); }
+
+    /**
+     get a page into the cache, reading it from the file if needed, and pin it
+     @param id is the page id
+     @return the pinned frame
+     */
+    frame* fetch(std::uint64_t id);
+
+    /**
+     add a new, empty page at the end of the file and pin it
+     @param leaf is whether the page is a leaf
+     @return the pinned frame
+     */
+    frame* allocate(bool leaf);
+
+    /**
+     make room for one more frame, writing back a batch of dirty pages if the victim is dirty
+     */
+    void evict_one();
+
+    /**
+     write dirty pages back to the file, in page order so the writes are as sequential as possible
+     @param batch are the frames to write
+     */
+    void write_back(std::vector<frame*>& batch);
+
+    /**
+     position of the first value not smaller than value within a page
+     @param f is the page
+     @param value is the value to look for
+     @return the index, count_of(f) if every value is smaller
+     */
+    size_t lower_index(const frame* f, const T& value) const;
+
+    /**
+     position of the child of an inner page that may hold value
+     @param f is the inner page
+     @param value is the value to look for
+     @return the child index
+     */
+    size_t child_index(const frame* f, const T& value) const;
+
+    /**
+     insert into the subtree below a page, splitting pages on the way back up
+     @param id is the page id
+     @param value is the value to insert
+     @return whether it was inserted, and the split the parent must absorb
+     */
+    split_result insert_into(std::uint64_t id, const T& value);
+
+public:
+    /**
+     the ordered iterator of a disk_set, it walks the leaf pages left to right
+     it refers to a page and a slot, so any insert or erase invalidates it
+     */
+    class iterator;
+
+    /**
+     constructor, opens the set stored in a file, creating the file if it does not exist
+     @param path is the file
+     @param _options are the memory budget and write batching settings
+     @param _pred is the given compare type
+     */
+    explicit disk_set(const std::string& path, const disk_set_options& _options = disk_set_options(), const compare_type& _pred = compare_type());
+
+    disk_set(const disk_set&) = delete;
+    disk_set& operator=(const disk_set&) = delete;
+
+    /**
+     destructor, writes every dirty page and the meta data back before closing the file
+     */
+    ~disk_set();
+
+    /**
+     insert a value
+     @param value is the value to insert
+     @return true if it was inserted, false if it was already there
+     */
+    bool insert(const T& value);
+
+    /**
+     construct a value in place and insert it
+     @tparam Args are the arguments passed in to emplace together
+     @return true if it was inserted, false if it was already there
+     */
+    template< typename... Args >
+    bool emplace(Args&&... values) { return insert(T(std::forward< Args >(values)...)); }
+
+    /**
+     locate a value
+     @param value is the value to look for
+     @return an iterator to it, or end() if it is not there
+     */
+    iterator find(const T& value);
+
+    /**
+     remove a value, pages are not merged when they run low and an empty leaf stays in the chain until the file is rebuilt
+     @param value is the value to remove
+     @return the number of values removed, 0 or 1
+     */
+    size_t erase(const T& value);
+
+    /**
+     remove the value an iterator points to
+     @param iter is an iterator to identify in the set
+     */
+    void erase(iterator iter);
+
+    /**
+     @return an iterator to the smallest value
+     */
+    iterator begin();
+
+    /**
+     @return the past-the-end iterator
+     */
+    iterator end();
+
+    /**
+     @return the number of values in the set
+     */
+    size_t size() const { return static_cast<size_t>(info.size); }
+
+    /**
+     @return the memory the page cache currently uses, in bytes, which never exceeds the memory budget
+     */
+    size_t memory_used() const { return frames.size() * frame_cost(); }
+
+    /**
+     write every dirty page and the meta data back to the file
+     @param durable is whether to also wait for the data to reach the disk with fdatasync
+     */
+    void flush(bool durable = false);
+};
+
+template< typename T, typename compare_type >
+class disk_set<T, compare_type>::pinned
+{
+private:
+    frame* f;
+public:
+    explicit pinned(frame* _f) : f(_f) { }
+    pinned(const pinned&) = delete;
+    pinned& operator=(const pinned&) = delete;
+    ~pinned() { --f->pins; }
+    frame* operator->() const { return f; }
+    frame* get() const { return f; }
+};
+
+template< typename T, typename compare_type >
+class disk_set<T, compare_type>::iterator
+{
+    friend disk_set;
+private:
+    disk_set* container = nullptr;
+    std::uint64_t page = no_page; // current leaf, no_page means past the end
+    size_t slot = 0; // index within the leaf
+    T current{}; // copy of the value, pages may be evicted while the iterator is alive
+
+    iterator(disk_set* _container, std::uint64_t _page, size_t _slot) : container(_container), page(_page), slot(_slot) { settle(); }
+
+    /**
+     move forward over empty leaves and past the end of the current one, then load the value
+     */
+    void settle();
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    iterator() = default;
+
+    /**
+     prefix increment for iterator
+    */
+    iterator& operator++() { ++slot; settle(); return *this; }
+
+    /**
+     postfix increment for iterator
+    */
+    iterator operator++(int) { iterator copy(*this); ++(*this); return copy; }
+
+    /**
+     @return the value the iterator points to
+    */
+    const T& operator*() const { return current; }
+    const T* operator->() const { return &current; }
+
+    bool operator==(const iterator& other) const { return page == other.page && slot == other.slot; }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+};
+
+template< typename T, typename compare_type >
+void disk_set<T, compare_type>::iterator::settle()
+{
+    while (page != no_page)
+    {
+        pinned leaf(container->fetch(page));
+        if (slot < count_of(leaf.get())) { current = key_at(leaf.get(), slot); return; }
+        page = next_of(leaf.get()); // past this leaf, skip to the next one
+        slot = 0;
+    }
+    slot = 0;
+}
+
+template< typename T, typename compare_type >
+disk_set<T, compare_type>::disk_set(const std::string& path, const disk_set_options& _options, const compare_type& _pred) : pred(_pred), options(_options)
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { throw std::runtime_error("disk_set: cannot open " + path); }
+
+    std::memset(&info, 0, sizeof(info));
+    const ssize_t got = ::pread(fd, &info, sizeof(info), 0);
+    if (got == 0) // new file, write the meta page and an empty root leaf
+    {
+        std::memcpy(info.magic, "rbtdisk1", 8);
+        info.page_size = options.page_size;
+        info.value_size = sizeof(T);
+        info.page_count = 1;
+    }
+    else if (got != static_cast<ssize_t>(sizeof(info)) || std::memcmp(info.magic, "rbtdisk1", 8) != 0 || info.value_size != sizeof(T))
+    {
+        ::close(fd);
+        throw std::runtime_error("disk_set: " + path + " is not a disk_set file for this value type");
+    }
+
+    leaf_capacity = (info.page_size - header_size) / sizeof(T);
+    inner_capacity = (info.page_size - header_size - 8) / (sizeof(T) + 8);
+    max_frames = options.memory_budget / frame_cost();
+    if (info.page_size < sizeof(meta) || leaf_capacity < 2 || inner_capacity < 2 || max_frames < 8) // page 0 holds the whole meta, and a root-to-leaf path must fit in the cache pinned
+    {
+        ::close(fd);
+        throw std::runtime_error("disk_set: page size or memory budget too small");
+    }
+
+    if (info.root == no_page)
+    {
+        pinned root(allocate(true));
+        info.root = info.first_leaf = root->id;
+    }
+}
+
+template< typename T, typename compare_type >
+disk_set<T, compare_type>::~disk_set()
+{
+    try { flush(); } catch (...) { } // a destructor must not throw, the data stays as durable as the last explicit flush
+    for (auto& entry : frames) { delete entry.second; }
+    ::close(fd);
+}
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::frame* disk_set<T, compare_type>::fetch(std::uint64_t id)
+{
+    auto found = frames.find(id);
+    if (found != frames.end()) // hit, move it to the front of the LRU list
+    {
+        frame* f = found->second;
+        lru.splice(lru.begin(), lru, f->lru);
+        ++f->pins;
+        return f;
+    }
+    if (frames.size() >= max_frames) { evict_one(); }
+    frame* f = new frame;
+    f->id = id;
+    f->data.resize(info.page_size);
+    const ssize_t got = ::pread(fd, f->data.data(), info.page_size, static_cast<off_t>(id * info.page_size));
+    if (got != static_cast<ssize_t>(info.page_size))
+    {
+        delete f;
+        throw std::runtime_error("disk_set: failed reading a page");
+    }
+    lru.push_front(f);
+    f->lru = lru.begin();
+    frames.emplace(id, f);
+    ++f->pins;
+    return f;
+}
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::frame* disk_set<T, compare_type>::allocate(bool leaf)
+{
+    if (frames.size() >= max_frames) { evict_one(); }
+    frame* f = new frame;
+    f->id = info.page_count++;
+    f->data.assign(info.page_size, 0);
+    f->dirty = true; // it only exists in memory until written back
+    set_leaf(f, leaf);
+    lru.push_front(f);
+    f->lru = lru.begin();
+    frames.emplace(f->id, f);
+    ++f->pins;
+    return f;
+}
+
+template< typename T, typename compare_type >
+void disk_set<T, compare_type>::evict_one()
+{
+    // the victim is the least recently used page nobody has pinned
+    auto victim = lru.end();
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it)
+    {
+        if ((*it)->pins == 0) { victim = std::prev(it.base()); break; }
+    }
+    if (victim == lru.end()) { throw std::runtime_error("disk_set: every cached page is pinned"); }
+
+    if ((*victim)->dirty)
+    {
+        // write it back together with the next dirty pages from the cold end, so writes go out in batches;
+        // pinned pages are in use and may still change, so they wait for their own eviction or a flush
+        std::vector<frame*> batch;
+        for (auto it = lru.rbegin(); it != lru.rend() && batch.size() < options.write_batch; ++it)
+        {
+            if ((*it)->dirty && (*it)->pins == 0) { batch.push_back(*it); }
+        }
+        write_back(batch);
+    }
+    frame* f = *victim;
+    lru.erase(victim);
+    frames.erase(f->id);
+    delete f;
+}
+
+template< typename T, typename compare_type >
+void disk_set<T, compare_type>::write_back(std::vector<frame*>& batch)
+{
+    std::sort(batch.begin(), batch.end(), [](const frame* a, const frame* b) { return a->id < b->id; });
+    for (frame* f : batch)
+    {
+        const char* data = f->data.data();
+        size_t left = info.page_size;
+        off_t at = static_cast<off_t>(f->id * info.page_size);
+        while (left > 0)
+        {
+            const ssize_t n = ::pwrite(fd, data, left, at);
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n <= 0) { throw std::runtime_error("disk_set: failed writing a page"); }
+            data += n; left -= static_cast<size_t>(n); at += n;
+        }
+        f->dirty = false;
+    }
+}
+
+template< typename T, typename compare_type >
+void disk_set<T, compare_type>::flush(bool durable)
+{
+    std::vector<frame*> batch;
+    for (auto& entry : frames)
+    {
+        if (entry.second->dirty) { batch.push_back(entry.second); }
+    }
+    write_back(batch);
+    std::vector<char> page(info.page_size, 0);
+    std::memcpy(page.data(), &info, sizeof(info));
+    if (::pwrite(fd, page.data(), page.size(), 0) != static_cast<ssize_t>(page.size())) { throw std::runtime_error("disk_set: failed writing the meta page"); }
+    if (durable && ::fdatasync(fd) != 0) { throw std::runtime_error("disk_set: fdatasync failed"); }
+}
+
+template< typename T, typename compare_type >
+size_t disk_set<T, compare_type>::lower_index(const frame* f, const T& value) const
+{
+    size_t first = 0, len = count_of(f);
+    while (len > 0)
+    {
+        const size_t half = len / 2;
+        if (pred(key_at(f, first + half), value)) { first += half + 1; len -= half + 1; }
+        else { len = half; }
+    }
+    return first;
+}
+
+template< typename T, typename compare_type >
+size_t disk_set<T, compare_type>::child_index(const frame* f, const T& value) const
+{
+    // separator i is the smallest value of child i + 1, so go right of every separator not larger than value
+    size_t first = 0, len = count_of(f);
+    while (len > 0)
+    {
+        const size_t half = len / 2;
+        if (!pred(value, key_at(f, first + half))) { first += half + 1; len -= half + 1; }
+        else { len = half; }
+    }
+    return first;
+}
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::split_result disk_set<T, compare_type>::insert_into(std::uint64_t id, const T& value)
+{
+    pinned page(fetch(id));
+    frame* f = page.get();
+    split_result result;
+
+    if (is_leaf(f))
+    {
+        const size_t at = lower_index(f, value);
+        const size_t n = count_of(f);
+        if (at < n && !pred(value, key_at(f, at))) { return result; } // duplicate
+        result.inserted = true;
+        f->dirty = true;
+        char* keys = f->data.data() + header_size;
+        std::memmove(keys + (at + 1) * sizeof(T), keys + at * sizeof(T), (n - at) * sizeof(T));
+        set_key(f, at, value);
+        set_count(f, n + 1);
+        if (n + 1 <= leaf_capacity - 1) { return result; } // keep one free slot so the shift above never overruns
+
+        // split the full leaf in half, the right half moves to a new page linked after this one
+        pinned right(allocate(true));
+        f->dirty = true; // allocate may have evicted, and written this page back clean, before the split below changes it
+        const size_t keep = (n + 1) / 2;
+        std::memcpy(right->data.data() + header_size, keys + keep * sizeof(T), (n + 1 - keep) * sizeof(T));
+        set_count(right.get(), n + 1 - keep);
+        set_count(f, keep);
+        set_next(right.get(), next_of(f));
+        set_next(f, right->id);
+        result.split = true;
+        result.separator = key_at(right.get(), 0);
+        result.right = right->id;
+        return result;
+    }
+
+    const size_t at = child_index(f, value);
+    split_result below = insert_into(child_at(f, at), value);
+    result.inserted = below.inserted;
+    if (!below.split) { return result; }
+
+    // absorb the child's split: the separator goes in at position at, the new page right after child at
+    f->dirty = true;
+    const size_t n = count_of(f);
+    char* keys = f->data.data() + header_size;
+    std::memmove(keys + (at + 1) * sizeof(T), keys + at * sizeof(T), (n - at) * sizeof(T));
+    set_key(f, at, below.separator);
+    for (size_t i = n + 1; i > at + 1; --i) { set_child(f, i, child_at(f, i - 1)); }
+    set_child(f, at + 1, below.right);
+    set_count(f, n + 1);
+    if (n + 1 <= inner_capacity - 1) { return result; }
+
+    // split the full inner page, the middle separator moves up
+    pinned right(allocate(false));
+    f->dirty = true; // as for a leaf split, a write-back inside allocate may have cleared it
+    const size_t total = n + 1;
+    const size_t mid = total / 2;
+    for (size_t i = mid + 1; i < total; ++i) { set_key(right.get(), i - mid - 1, key_at(f, i)); }
+    for (size_t i = mid + 1; i <= total; ++i) { set_child(right.get(), i - mid - 1, child_at(f, i)); }
+    set_count(right.get(), total - mid - 1);
+    set_count(f, mid);
+    result.split = true;
+    result.separator = key_at(f, mid);
+    result.right = right->id;
+    return result;
+}
+
+template< typename T, typename compare_type >
+bool disk_set<T, compare_type>::insert(const T& value)
+{
+    split_result result = insert_into(info.root, value);
+    if (result.split) // the root split, grow the tree by one level
+    {
+        pinned root(allocate(false));
+        set_key(root.get(), 0, result.separator);
+        set_child(root.get(), 0, info.root);
+        set_child(root.get(), 1, result.right);
+        set_count(root.get(), 1);
+        info.root = root->id;
+    }
+    if (result.inserted) { ++info.size; }
+    return result.inserted;
+}
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::iterator disk_set<T, compare_type>::find(const T& value)
+{
+    std::uint64_t id = info.root;
+    while (true)
+    {
+        pinned page(fetch(id));
+        if (is_leaf(page.get()))
+        {
+            const size_t at = lower_index(page.get(), value);
+            if (at < count_of(page.get()) && !pred(value, key_at(page.get(), at))) { return iterator(this, id, at); }
+            return end();
+        }
+        id = child_at(page.get(), child_index(page.get(), value));
+    }
+}
+
+template< typename T, typename compare_type >
+size_t disk_set<T, compare_type>::erase(const T& value)
+{
+    iterator iter = find(value);
+    if (iter == end()) { return 0; }
+    erase(iter);
+    return 1;
+}
+
+template< typename T, typename compare_type >
+void disk_set<T, compare_type>::erase(iterator iter)
+{
+    if (iter.container != this || iter.page == no_page) { return; }
+    pinned leaf(fetch(iter.page));
+    const size_t n = count_of(leaf.get());
+    char* keys = leaf->data.data() + header_size;
+    std::memmove(keys + iter.slot * sizeof(T), keys + (iter.slot + 1) * sizeof(T), (n - iter.slot - 1) * sizeof(T));
+    set_count(leaf.get(), n - 1);
+    leaf->dirty = true;
+    --info.size;
+}
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::iterator disk_set<T, compare_type>::begin() { return iterator(this, info.first_leaf, 0); }
+
+template< typename T, typename compare_type >
+typename disk_set<T, compare_type>::iterator disk_set<T, compare_type>::end() { return iterator(this, no_page, 0); }
+
+#endif /* disk_set_h */
@@ -0,0 +1,324 @@
+#ifndef durable_rbt_h
+#define durable_rbt_h
+#include "rbt.h"
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ the durability settings of a durable_rbt
+ group_size is how many logged operations are gathered before they are written to the log together
+ sync_every is how many group writes happen between fdatasync calls, 0 never syncs and leaves it to the operating system
+ checkpoint_every is how many logged operations happen between snapshots, 0 only checkpoints when asked
+ */
+struct durable_rbt_options
+{
+    size_t group_size = 64;
+    size_t sync_every = 1;
+    size_t checkpoint_every = size_t(1) << 20;
+};
+
+/**
+ an rbt whose insert, emplace and erase are recorded in an append-only write-ahead log, so it survives a crash
+ on startup the last snapshot is loaded and the log written since is replayed on top of it
+ every operation is a set operation, so replaying a log over a snapshot that already contains some of it gives the same tree
+ the files used are path + ".snapshot" and path + ".log"
+ @tparam T is the data stored in the rbt, it must have an rbt_serializer
+ @tparam compare_type is the rule to compare node values (of type T)
+*/
+template< typename T, typename compare_type = std::less< T > >
+class durable_rbt
+{
+private:
+    enum op : std::uint8_t { op_insert = 1, op_erase = 2 };
+
+    rbt<T, compare_type> tree;
+    durable_rbt_options options;
+    std::string snapshot_path;
+    std::string log_path;
+    int log_fd = -1;
+    std::string pending; // records waiting for the next group write
+    size_t pending_records = 0;
+    size_t unsynced_groups = 0;
+    size_t since_checkpoint = 0;
+    std::ostringstream scratch; // reused to serialise each value
+
+    /**
+     a 32-bit FNV-1a checksum, enough to tell a torn record at the end of the log from a whole one
+     @param data is the start of the bytes
+     @param len is how many bytes
+     @param hash is the running checksum
+     @return the checksum
+     */
+    static std::uint32_t checksum(const char* data, size_t len, std::uint32_t hash = 2166136261u);
+
+    /**
+     add a record to the pending group, writing the group out once it is full
+     @param kind is the operation
+     @param value is its argument
+     */
+    void log(op kind, const T& value);
+
+    /**
+     write all of a buffer to the log
+     @param data is the start of the bytes
+     @param len is how many bytes
+     */
+    void write_all(const char* data, size_t len);
+
+    /**
+     apply every whole record in the log to the tree, and cut off a torn record at the end if there is one
+     */
+    void replay();
+
+    /**
+     count an operation towards the next checkpoint, and take it if it is due
+     */
+    void maybe_checkpoint();
+
+public:
+    /**
+     constructor, recovers the tree from its snapshot and log, creating them if they do not exist
+     @param path is the prefix of the snapshot and log files
+     @param _options are the group commit, sync and checkpoint settings
+     @param _pred is the given compare type
+     */
+    explicit durable_rbt(const std::string& path, const durable_rbt_options& _options = durable_rbt_options(), const compare_type& _pred = compare_type());
+
+    durable_rbt(const durable_rbt&) = delete;
+    durable_rbt& operator=(const durable_rbt&) = delete;
+
+    /**
+     destructor, commits what is pending and closes the log
+     */
+    ~durable_rbt();
+
+    /**
+     insert a value, it is durable once the group it is in has been synced
+     @param value is the value to insert
+     */
+    void insert(const T& value);
+
+    /**
+     construct a value and insert it
+     @tparam Args are the arguments passed in to emplace together
+     */
+    template< typename... Args >
+    void emplace(Args&&... values);
+
+    /**
+     erase the value an iterator points to
+     @param iter is an iterator to identify in the rbt
+     */
+    void erase(typename rbt<T, compare_type>::iterator iter);
+
+    /**
+     write the pending group to the log now, and sync it if requested
+     @param durable is whether to fdatasync the log regardless of sync_every
+     */
+    void commit(bool durable = false);
+
+    /**
+     write a snapshot of the tree and start a new, empty log
+     */
+    void checkpoint();
+
+    /**
+     locate a value in the rbt
+     @param value is the value to look for
+     @return its iterator, or end() if not found
+     */
+    typename rbt<T, compare_type>::iterator find(const T& value) { return tree.find(value); }
+
+    typename rbt<T, compare_type>::iterator begin() { return tree.begin(); }
+    typename rbt<T, compare_type>::iterator end() { return tree.end(); }
+    typename rbt<T, compare_type>::const_iterator begin() const { return tree.begin(); }
+    typename rbt<T, compare_type>::const_iterator end() const { return tree.end(); }
+
+    /**
+     @return the number of values in the rbt
+     */
+    size_t size() { return tree.size(); }
+};
+
+template< typename T, typename compare_type >
+std::uint32_t durable_rbt<T, compare_type>::checksum(const char* data, size_t len, std::uint32_t hash)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template< typename T, typename compare_type >
+durable_rbt<T, compare_type>::durable_rbt(const std::string& path, const durable_rbt_options& _options, const compare_type& _pred) :
+    tree(_pred), options(_options), snapshot_path(path + ".snapshot"), log_path(path + ".log")
+{
+    if (options.group_size == 0) { options.group_size = 1; }
+    if (::access(snapshot_path.c_str(), F_OK) == 0) { tree.load(snapshot_path); }
+    log_fd = ::open(log_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (log_fd < 0) { throw std::runtime_error("durable_rbt: cannot open " + log_path); }
+    replay();
+}
+
+template< typename T, typename compare_type >
+durable_rbt<T, compare_type>::~durable_rbt()
+{
+    try { commit(options.sync_every != 0); } catch (...) { } // a destructor must not throw
+    ::close(log_fd);
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::write_all(const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t n = ::write(log_fd, data, len);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { throw std::runtime_error("durable_rbt: failed writing " + log_path); }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::log(op kind, const T& value)
+{
+    // record: 32-bit payload length, op byte, payload, 32-bit checksum of everything before it
+    scratch.str(std::string());
+    rbt_serializer<T>::write(scratch, value);
+    const std::string payload = scratch.str();
+    const std::uint32_t len = static_cast<std::uint32_t>(payload.size());
+    const size_t start = pending.size();
+    pending.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    pending.push_back(static_cast<char>(kind));
+    pending.append(payload);
+    const std::uint32_t sum = checksum(pending.data() + start, pending.size() - start);
+    pending.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    if (++pending_records >= options.group_size) { commit(); }
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::commit(bool durable)
+{
+    if (!pending.empty())
+    {
+        write_all(pending.data(), pending.size());
+        pending.clear();
+        pending_records = 0;
+        ++unsynced_groups;
+    }
+    const bool due = options.sync_every != 0 && unsynced_groups >= options.sync_every;
+    if ((durable || due) && unsynced_groups != 0)
+    {
+        if (::fdatasync(log_fd) != 0) { throw std::runtime_error("durable_rbt: fdatasync failed on " + log_path); }
+        unsynced_groups = 0;
+    }
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::replay()
+{
+    std::ifstream in(log_path, std::ios::binary | std::ios::ate);
+    const std::streamoff file_size = in.tellg();
+    in.seekg(0);
+    std::string payload;
+    std::streamoff good = 0; // end of the last whole record
+    while (true)
+    {
+        std::uint32_t len = 0, sum = 0;
+        char kind = 0;
+        if (!in.read(reinterpret_cast<char*>(&len), sizeof(len)) || !in.get(kind)) { break; }
+        if (len > file_size - in.tellg()) { break; } // a torn length, do not allocate for a record the file cannot hold
+        payload.resize(len);
+        if (!in.read(&payload[0], len) || !in.read(reinterpret_cast<char*>(&sum), sizeof(sum))) { break; }
+        std::uint32_t expected = checksum(reinterpret_cast<const char*>(&len), sizeof(len));
+        expected = checksum(&kind, 1, expected);
+        expected = checksum(payload.data(), payload.size(), expected);
+        if (sum != expected) { break; }
+
+        std::istringstream record(payload);
+        T value = rbt_serializer<T>::read(record);
+        if (kind == op_insert) { tree.insert(std::move(value)); }
+        else if (kind == op_erase) { tree.erase(value); }
+        else { break; }
+        good = in.tellg();
+        ++since_checkpoint;
+    }
+    // anything after the last whole record was torn by the crash, drop it so new records follow whole ones
+    if (::ftruncate(log_fd, static_cast<off_t>(good)) != 0) { throw std::runtime_error("durable_rbt: cannot truncate " + log_path); }
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::maybe_checkpoint()
+{
+    if (options.checkpoint_every != 0 && ++since_checkpoint >= options.checkpoint_every) { checkpoint(); }
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::checkpoint()
+{
+    commit();
+    // write the snapshot beside the old one and rename it over, so a crash leaves one whole snapshot either way
+    const std::string temp_path = snapshot_path + ".tmp";
+    tree.save(temp_path);
+    const int fd = ::open(temp_path.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) != 0)
+    {
+        if (fd >= 0) { ::close(fd); }
+        throw std::runtime_error("durable_rbt: cannot sync " + temp_path);
+    }
+    ::close(fd);
+    if (std::rename(temp_path.c_str(), snapshot_path.c_str()) != 0) { throw std::runtime_error("durable_rbt: cannot replace " + snapshot_path); }
+    // the rename lives in the directory, it has to be on disk before the log is emptied or a power loss could keep the
+    // truncate and lose the rename, leaving the old snapshot with no log
+    const size_t slash = snapshot_path.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : snapshot_path.substr(0, slash);
+    const int dir_fd = ::open(directory.c_str(), O_RDONLY);
+    if (dir_fd < 0 || ::fsync(dir_fd) != 0)
+    {
+        if (dir_fd >= 0) { ::close(dir_fd); }
+        throw std::runtime_error("durable_rbt: cannot sync " + directory);
+    }
+    ::close(dir_fd);
+    // the snapshot now covers the whole log, a crash before this truncate only replays operations it already has
+    if (::ftruncate(log_fd, 0) != 0 || ::fdatasync(log_fd) != 0) { throw std::runtime_error("durable_rbt: cannot reset " + log_path); }
+    unsynced_groups = 0;
+    since_checkpoint = 0;
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::insert(const T& value)
+{
+    log(op_insert, value);
+    tree.insert(value);
+    maybe_checkpoint();
+}
+
+template< typename T, typename compare_type >
+template< typename... Args >
+void durable_rbt<T, compare_type>::emplace(Args&&... values)
+{
+    T value(std::forward< Args >(values)...);
+    log(op_insert, value);
+    tree.insert(std::move(value));
+    maybe_checkpoint();
+}
+
+template< typename T, typename compare_type >
+void durable_rbt<T, compare_type>::erase(typename rbt<T, compare_type>::iterator iter)
+{
+    if (iter == tree.end()) { return; }
+    log(op_erase, *iter);
+    tree.erase(iter);
+    maybe_checkpoint();
+}
+
+#endif /* durable_rbt_h */
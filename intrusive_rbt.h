@@ -0,0 +1,558 @@
+#ifndef intrusive_rbt_h
+#define intrusive_rbt_h
+#include "rbt.h"
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ the links an object needs to be in an intrusive_rbt, embedded in the object itself
+ an object can hold several hooks and be in one tree through each of them, e.g. a primary index and secondary indexes
+ the hook has the same left, right, parent and balance as rbt's nodes, so rbt_red_black, rbt_avl and rbt_wavl balance it unchanged
+ an unlinked hook points its parent at itself; copying an object gives the copy unlinked hooks, since it is in no tree yet
+ */
+struct rbt_hook
+{
+    rbt_hook* left = nullptr; // left child
+    rbt_hook* right = nullptr; // right child
+    rbt_hook* parent = this; // parent hook, nullptr for the root, this when the hook is not in a tree
+    unsigned char balance = 0; // the balance_policy's information: the colour, height or rank
+
+    rbt_hook() = default;
+    rbt_hook(const rbt_hook&) { } // a copy is not in the tree the original is in
+    rbt_hook& operator=(const rbt_hook&) { return *this; } // assigning an object's fields leaves its tree links alone
+
+    /**
+     @return true if the hook is in a tree
+     */
+    bool linked() const { return parent != this; }
+
+    /**
+     mark the hook as in no tree
+     */
+    void reset() { left = right = nullptr; parent = this; balance = 0; }
+
+    /**
+     set the balance information of this hook, counting it as a recolouring if it changes
+     @param _balance is the new colour, height or rank
+     @param stats is where the recolouring is counted
+     */
+    template< typename Stats >
+    void set_balance(unsigned char _balance, Stats stats)
+    {
+        if (balance != _balance) { stats.recolour(); balance = _balance; }
+    }
+
+    /**
+     rotate left about this hook, only changes connection
+     @param stats is where the rotation is counted
+     */
+    template< typename Stats >
+    void left_rotate(Stats stats) { rbt_links::rotate_left(this, stats); }
+
+    /**
+     rotate right about this hook, only changes connection
+     @param stats is where the rotation is counted
+     */
+    template< typename Stats >
+    void right_rotate(Stats stats) { rbt_links::rotate_right(this, stats); }
+
+    /**
+     find the in-order successor by following pointers only
+     @return the next larger hook, nullptr if this is the largest
+     */
+    rbt_hook* successor() const { return rbt_links::successor(const_cast<rbt_hook*>(this)); }
+
+    /**
+     find the in-order predecessor by following pointers only
+     @return the next smaller hook, nullptr if this is the smallest
+     */
+    rbt_hook* predecessor() const { return rbt_links::predecessor(const_cast<rbt_hook*>(this)); }
+};
+
+/**
+ an ordered set of objects the caller owns, linked in place through an rbt_hook member, so inserting neither copies nor allocates
+ the tree only keeps pointers to the hooks: an object must stay where it is while it is linked, and must be unlinked
+ (or the tree cleared or destroyed) before the object goes away
+ the balancing, relinking and validation are rbt's own balance_policy and rbt_links code, run on the hooks; lookups map a hook back to its object by the member's offset
+ example, orders indexed by id and by price at once:
+    struct order { long id; double price; rbt_hook by_id, by_price; };
+    intrusive_rbt<order, &order::by_id, order_id_less> ids;
+    intrusive_rbt<order, &order::by_price, order_price_less> prices;
+    ids.insert(o); prices.insert(o);
+ @tparam T is the type of the objects, with an rbt_hook member
+ @tparam hook is that member, one per tree the object can be in
+ @tparam compare_type is the rule to compare objects
+ @tparam stats_policy is rbt_no_stats (the default, no cost) or rbt_count_stats to count what the tree does
+ @tparam balance_policy is rbt_red_black (the default), rbt_avl or rbt_wavl
+*/
+template< typename T, rbt_hook T::*hook, typename compare_type = std::less< T >, typename stats_policy = rbt_no_stats, typename balance_policy = rbt_red_black >
+class intrusive_rbt : private stats_policy
+{
+private:
+    using stats_handle_type = typename stats_policy::handle;
+    using three_way = rbt_three_way<T, compare_type>; // how walks down the tree compare, chosen at compile time
+    rbt_hook* root = nullptr;
+    rbt_hook* leftmost = nullptr; // the smallest object's hook, so begin() is O(1)
+    rbt_hook* rightmost = nullptr; // the largest object's hook, which --end() reaches in O(1)
+    compare_type pred;
+    size_t tree_size = 0;
+
+    /**
+     @return how far the hook member is from the start of a T, measured on first use and kept
+     */
+    static std::ptrdiff_t hook_offset();
+
+    /**
+     @return how far the hook member is from the start of a T, measured on storage for a T that is never constructed
+     */
+    static std::ptrdiff_t measure_hook_offset();
+
+    /**
+     @return the object a hook is embedded in
+     */
+    static T& owner(rbt_hook* h) { return *reinterpret_cast<T*>(reinterpret_cast<char*>(h) - hook_offset()); }
+    static const T& owner(const rbt_hook* h) { return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(h) - hook_offset()); }
+
+    /**
+     @return the first hook whose object is not smaller than value, nullptr if there is none
+     */
+    rbt_hook* lower_bound_hook(const T& value) const;
+
+    /**
+     @return the hook of the object equivalent to value, nullptr if there is none
+     */
+    rbt_hook* find_hook(const T& value) const;
+
+    /**
+     unlink a hook from the tree, reset it, and let the balance_policy restore the balance
+     @param doomed is the hook to remove
+     */
+    void unlink_hook(rbt_hook* doomed);
+
+    /**
+     rotations only ever move the root down by one parent link, walk it back up
+     */
+    void fix_root() { if (root != nullptr) { while (root->parent != nullptr) { root = root->parent; } } }
+
+public:
+    template< bool is_const >
+    class basic_iterator;
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /**
+     constructor, an empty tree
+     @param _pred is the given compare type
+     */
+    explicit intrusive_rbt(const compare_type& _pred = compare_type()) : pred(_pred) { }
+
+    /**
+     the tree only holds links into objects, a copy would need the same objects to be in two places
+     */
+    intrusive_rbt(const intrusive_rbt&) = delete;
+    intrusive_rbt& operator=(const intrusive_rbt&) = delete;
+
+    /**
+     move constructor, O(1): no hook points at the tree itself
+     @param other is the tree to take the objects of, left empty
+     */
+    intrusive_rbt(intrusive_rbt&& other) noexcept : stats_policy(other), pred(other.pred) { swap(other); }
+
+    /**
+     move assignment, the objects linked here before are unlinked first
+     @param other is the tree to take the objects of, left empty
+     @return this tree
+     */
+    intrusive_rbt& operator=(intrusive_rbt&& other) noexcept;
+
+    /**
+     destructor, unlinks every object so none is left pointing into a tree that is gone; the objects themselves are untouched
+     */
+    ~intrusive_rbt() { clear(); }
+
+    /**
+     link an object into the tree in place
+     @param object is the object, whose hook must not be linked
+     @return true if it was linked, false if an equivalent object is already there, in which case its hook stays unlinked
+     @throws std::invalid_argument if the object's hook is already in a tree
+     */
+    bool insert(T& object);
+
+    /**
+     unlink an object that is in this tree, the object is untouched apart from its hook
+     the object must be in this tree, not in another tree through the same hook member, which would corrupt both;
+     builds without NDEBUG check that by walking up to the root
+     @param object is the object
+     @throws std::invalid_argument if the object's hook is in no tree, or, without NDEBUG, in another tree
+     */
+    void unlink(T& object);
+
+    /**
+     unlink the object an iterator points to
+     @param iter is an iterator to an object in the tree
+     @return an iterator to the object after it, or end()
+     */
+    iterator erase(iterator iter);
+
+    /**
+     unlink the object equivalent to the given value, if there is one
+     @param value is the value to look for
+     @return the number of objects unlinked, 0 or 1
+     */
+    size_t erase(const T& value);
+
+    /**
+     unlink every object, O(n), and leave the tree empty
+     */
+    void clear();
+
+    /**
+     locate an object equivalent to a value
+     @param value is the value to look for
+     @return its iterator, or end() if not found
+     */
+    iterator find(const T& value) { return iterator(find_hook(value), this); }
+    const_iterator find(const T& value) const { return const_iterator(find_hook(value), this); }
+
+    /**
+     find the first object not smaller than a value
+     @param value is the value to look for
+     @return its iterator, or end() if every object is smaller
+     */
+    iterator lower_bound(const T& value) { return iterator(lower_bound_hook(value), this); }
+    const_iterator lower_bound(const T& value) const { return const_iterator(lower_bound_hook(value), this); }
+
+    /**
+     an iterator to an object known to be in this tree, without a search; with several hooks, this moves from one index to another
+     @param object is the object
+     @return its iterator
+     */
+    iterator iterator_to(T& object) { return iterator(&(object.*hook), this); }
+    const_iterator iterator_to(const T& object) const { return const_iterator(const_cast<rbt_hook*>(&(object.*hook)), this); }
+
+    iterator begin() { return iterator(leftmost, this); }
+    iterator end() { return iterator(nullptr, this); }
+    const_iterator begin() const { return const_iterator(leftmost, this); }
+    const_iterator end() const { return const_iterator(nullptr, this); }
+
+    /**
+     @return the number of objects in the tree
+     */
+    size_t size() const { return tree_size; }
+
+    /**
+     @return true if no object is linked
+     */
+    bool empty() const { return tree_size == 0; }
+
+    /**
+     swap the objects of two trees, O(1)
+     @param other is the tree to swap with
+     */
+    void swap(intrusive_rbt& other) noexcept;
+
+    /**
+     Check every invariant of the tree: the parent links, the order of the objects, the size and the balance_policy's own rules
+     @param problem is set to a description of the first broken invariant
+     @return true if the tree is valid
+     */
+    bool validate(std::string& problem) const;
+
+    /**
+     Check every invariant of the tree
+     @return true if the tree is valid
+     */
+    bool validate() const;
+
+    using stats_policy::stats;
+    using stats_policy::reset_stats;
+};
+
+/**
+ an iterator of an intrusive_rbt, in increasing order, that gives the objects themselves
+ */
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+template< bool is_const >
+class intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::basic_iterator
+{
+    friend intrusive_rbt;
+    friend class basic_iterator<!is_const>;
+private:
+    rbt_hook* this_hook = nullptr; // nullptr is past the end
+    const intrusive_rbt* container = nullptr; // for --end()
+    basic_iterator(rbt_hook* _hook, const intrusive_rbt* _container) : this_hook(_hook), container(_container) { }
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename std::conditional<is_const, const T*, T*>::type;
+    using reference = typename std::conditional<is_const, const T&, T&>::type;
+
+    basic_iterator() = default;
+
+    /**
+     an iterator converts to a const_iterator
+     */
+    template< bool other_const, typename = typename std::enable_if<is_const && !other_const>::type >
+    basic_iterator(const basic_iterator<other_const>& other) : this_hook(other.this_hook), container(other.container) { }
+
+    reference operator*() const { return owner(this_hook); }
+    pointer operator->() const { return &owner(this_hook); }
+    basic_iterator& operator++() { this_hook = this_hook->successor(); return *this; }
+    basic_iterator operator++(int) { basic_iterator copy(*this); ++(*this); return copy; }
+    basic_iterator& operator--() { this_hook = this_hook != nullptr ? this_hook->predecessor() : container->rightmost; return *this; }
+    basic_iterator operator--(int) { basic_iterator copy(*this); --(*this); return copy; }
+    bool operator==(const basic_iterator& other) const { return this_hook == other.this_hook; }
+    bool operator!=(const basic_iterator& other) const { return this_hook != other.this_hook; }
+};
+
+/**
+ non-member swap function for intrusive_rbt
+ @param tree1 is the "left hand side" intrusive_rbt
+ @param tree2 is the "right hand side" intrusive_rbt
+*/
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+void swap(intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>& tree1, intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>& tree2) { tree1.swap(tree2); }
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+std::ptrdiff_t intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::hook_offset()
+{
+    static const std::ptrdiff_t offset = measure_hook_offset(); // offsetof needs a member name, not a member pointer, so it is measured once
+    return offset;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+std::ptrdiff_t intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::measure_hook_offset()
+{
+    union probe
+    {
+        T object;
+        char bytes[sizeof(T)];
+        probe() { }
+        ~probe() { }
+    } p;
+    return reinterpret_cast<char*>(&(p.object.*hook)) - p.bytes;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+rbt_hook* intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::lower_bound_hook(const T& value) const
+{
+    const stats_handle_type stats = this->stats_handle();
+    rbt_hook* current = root;
+    rbt_hook* bound = nullptr;
+    size_t depth = 0;
+    while (current != nullptr)
+    {
+        stats.visit();
+        stats.compare();
+        ++depth;
+        if (pred(owner(current), value)) { current = current->right; } // too small, the bound is on the right
+        else { bound = current; current = current->left; }
+    }
+    stats.lookup_done(depth);
+    return bound;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+rbt_hook* intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::find_hook(const T& value) const
+{
+    if (!three_way::enabled)
+    {
+        // the lower bound and one more comparison
+        rbt_hook* bound = lower_bound_hook(value);
+        if (bound == nullptr) { return nullptr; }
+        this->stats_handle().compare();
+        return pred(value, owner(bound)) ? nullptr : bound;
+    }
+    const stats_handle_type stats = this->stats_handle();
+    rbt_hook* current = root;
+    size_t depth = 0;
+    while (current != nullptr)
+    {
+        stats.visit();
+        stats.compare();
+        ++depth;
+        const int order = three_way::compare(pred, value, owner(current));
+        if (order == 0) { break; }
+        current = order < 0 ? current->left : current->right;
+    }
+    stats.lookup_done(depth);
+    return current;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+bool intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::insert(T& object)
+{
+    rbt_hook* new_hook = &(object.*hook);
+    if (new_hook->linked()) { throw std::invalid_argument("intrusive_rbt::insert: the object is already in a tree through this hook"); }
+    const stats_handle_type stats = this->stats_handle();
+    if (root == nullptr)
+    {
+        new_hook->left = new_hook->right = new_hook->parent = nullptr;
+        new_hook->balance = balance_policy::leaf();
+        root = leftmost = rightmost = new_hook;
+        ++tree_size;
+        balance_policy::insert_fixup(new_hook, stats);
+        return true;
+    }
+    // walk down to the empty child the object belongs in, with one comparison per level, as rbt's insert_node does
+    rbt_hook* current = root;
+    rbt_hook* candidate = nullptr; // the last hook the object did not go left of, the only one it can be equal to
+    rbt_hook** slot = nullptr;
+    size_t depth = 0;
+    while (true)
+    {
+        stats.visit();
+        stats.compare();
+        ++depth;
+        bool to_left;
+        if (three_way::enabled)
+        {
+            const int order = three_way::compare(pred, object, owner(current));
+            if (order == 0) { stats.lookup_done(depth); return false; }
+            to_left = order < 0;
+        }
+        else
+        {
+            to_left = pred(object, owner(current));
+            if (!to_left) { candidate = current; }
+        }
+        slot = to_left ? &current->left : &current->right;
+        if (*slot == nullptr) { break; }
+        current = *slot;
+    }
+    stats.lookup_done(depth);
+    if (!three_way::enabled && candidate != nullptr)
+    {
+        stats.compare();
+        if (!pred(owner(candidate), object)) { return false; } // an equivalent object is already linked
+    }
+    new_hook->left = new_hook->right = nullptr;
+    new_hook->parent = current;
+    new_hook->balance = balance_policy::leaf();
+    *slot = new_hook;
+    // a new smallest or largest hook always hangs directly off the old one
+    if (new_hook == leftmost->left) { leftmost = new_hook; }
+    else if (new_hook == rightmost->right) { rightmost = new_hook; }
+    ++tree_size;
+    balance_policy::insert_fixup(new_hook, stats);
+    fix_root();
+    return true;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+void intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::unlink(T& object)
+{
+    rbt_hook* doomed = &(object.*hook);
+    if (!doomed->linked()) { throw std::invalid_argument("intrusive_rbt::unlink: the object is in no tree through this hook"); }
+#ifndef NDEBUG
+    const rbt_hook* top = doomed;
+    while (top->parent != nullptr) { top = top->parent; }
+    if (top != root) { throw std::invalid_argument("intrusive_rbt::unlink: the object is in another tree through this hook"); }
+#endif
+    unlink_hook(doomed);
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+void intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::unlink_hook(rbt_hook* doomed)
+{
+    rbt_links::unlink<balance_policy>(root, leftmost, rightmost, doomed, this->stats_handle());
+    doomed->reset();
+    --tree_size;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+typename intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::iterator intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::erase(iterator iter)
+{
+    if (iter.container != this || iter.this_hook == nullptr) { return end(); } // not in this tree, or end()
+    rbt_hook* next = iter.this_hook->successor(); // found before unlinking, the relinking never moves it
+    unlink_hook(iter.this_hook);
+    return iterator(next, this);
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+size_t intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::erase(const T& value)
+{
+    rbt_hook* found = find_hook(value);
+    if (found == nullptr) { return 0; }
+    unlink_hook(found);
+    return 1;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+void intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::clear()
+{
+    // take leaves off one at a time, walking back up through parents, so no stack is needed
+    rbt_hook* current = root;
+    while (current != nullptr)
+    {
+        if (current->left != nullptr) { current = current->left; }
+        else if (current->right != nullptr) { current = current->right; }
+        else
+        {
+            rbt_hook* up = current->parent;
+            if (up != nullptr)
+            {
+                if (up->left == current) { up->left = nullptr; }
+                else { up->right = nullptr; }
+            }
+            current->reset();
+            current = up;
+        }
+    }
+    root = leftmost = rightmost = nullptr;
+    tree_size = 0;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>& intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::operator=(intrusive_rbt&& other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+void intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::swap(intrusive_rbt& other) noexcept
+{
+    std::swap(root, other.root);
+    std::swap(leftmost, other.leftmost);
+    std::swap(rightmost, other.rightmost);
+    std::swap(pred, other.pred);
+    std::swap(tree_size, other.tree_size);
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+bool intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::validate(std::string& problem) const
+{
+    if (root == nullptr)
+    {
+        if (tree_size != 0) { problem = "empty tree with size " + std::to_string(tree_size); return false; }
+        return true;
+    }
+    auto in_order = [this](const rbt_hook* a, const rbt_hook* b) { return pred(owner(a), owner(b)); };
+    if (!rbt_links::validate<balance_policy>(root, tree_size, in_order, problem)) { return false; }
+    const rbt_hook* first = root;
+    const rbt_hook* last = root;
+    while (first->left != nullptr) { first = first->left; }
+    while (last->right != nullptr) { last = last->right; }
+    if (leftmost != first || rightmost != last) { problem = "stale smallest or largest object"; return false; }
+    return true;
+}
+
+template< typename T, rbt_hook T::*hook, typename compare_type, typename stats_policy, typename balance_policy >
+bool intrusive_rbt<T, hook, compare_type, stats_policy, balance_policy>::validate() const
+{
+    std::string problem;
+    return validate(problem);
+}
+
+#endif /* intrusive_rbt_h */
@@ -1,8 +1,11 @@
 #include "rbt.h"
 #include "Timer.h"
+#include "const_set.h"
 #include<iostream>
 #include<vector>
 #include<string>
+#include<sstream>
+#include<stdexcept>
 
 auto get_rbt() {
     rbt<double, std::greater<double>> vals;
@@ -59,6 +62,26 @@ int main() {
         std::cout << d << '\n';
     }
 
+    // stream the doubles out and read them back, a stream cut short is rejected without leaking what was read
+    std::stringstream run;
+    doubles.write_sorted(run, rbt_format::binary);
+    const std::string bytes = run.str();
+    rbt<double, std::greater<double>> read_back;
+    std::istringstream whole(bytes);
+    read_back.read_sorted(whole, rbt_format::binary);
+    std::cout << "read back " << read_back.size() << " doubles\n";
+    std::istringstream cut(bytes.substr(0, bytes.size() - 1));
+    try {
+        read_back.read_sorted(cut, rbt_format::binary);
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "cut stream: " << e.what() << ", still " << read_back.size() << " doubles\n";
+    }
+
+    // a static table is sorted by the compiler, so it costs nothing at startup
+    constexpr auto statuses = make_const_map<int, const char*>({ { 404, "not found" }, { 200, "ok" }, { 500, "server error" } });
+    std::cout << "status 404 means " << statuses.at(404) << '\n';
+
     rbt<int> ints;
     rbt<int> ints2;
 
@@ -66,24 +89,25 @@ int main() {
 
     std::cout << "now we do some time trails...\n";
     
-    simple_timer::timer<'u'> t;
+    simple_timer::timer<'n', double> t;
+    simple_timer::latency_histogram<> insert_times, erase_times; // record every operation, print once at the end
 
-    std::cout << "time each of 1000 inserations:\n";
     for (size_t i = 0ul; i < 1000ul; ++i) {
         t.tick();
         ints.insert(i);
-        std::cout << t.tock() << ' ';
+        insert_times.record(t.tock());
     }
-    std::cout << '\n';
 
-    std::cout << "time each of 1000 removals:\n";
     for (size_t i = 0ul; i < 1000ul; ++i) {
         t.tick();
-        auto p = ints.find(i);
-        ints.erase(p);
-        std::cout << t.tock() << ' ';
+        ints.erase(i);
+        erase_times.record(t.tock());
     }
-    std::cout << '\n';
+
+    std::cout << "time of 1000 insertions (ns):\n";
+    std::cout << "p50 " << insert_times.percentile(0.5) << " p99 " << insert_times.percentile(0.99) << " max " << insert_times.max() << '\n';
+    std::cout << "time of 1000 removals (ns):\n";
+    std::cout << "p50 " << erase_times.percentile(0.5) << " p99 " << erase_times.percentile(0.99) << " max " << erase_times.max() << '\n';
 
     return 0;
 }
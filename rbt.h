@@ -4,41 +4,1228 @@
 #include <functional>
 #include <stdexcept>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+// file descriptors and memory mapping, only for the fd overloads of the streaming functions and for rbt::map
+#define RBT_POSIX 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define RBT_POSIX 0
+#endif
+#include <cerrno>
+#include <iterator>
+#include <cstddef>
+#include <cmath>
+#include <new>
+#if __cplusplus >= 202002L
+#include <ranges>
+#include <compare>
+#include <concepts>
+#endif
+
+/**
+ a snapshot of the counters an instrumented rbt keeps
+ comparisons are calls to the compare type (or ==), rotations are left_rotate/right_rotate calls,
+ recolourings are changes to a node's balance (its colour, height or rank), fixup_iterations are steps of the insert and erase rebalancing,
+ allocations are nodes created, and each lookup (a walk for find, lower bound or insert) adds the nodes it visited
+ depth_histogram[d] counts the lookups that visited d nodes, the last bucket also counts everything deeper
+ */
+struct rbt_stats
+{
+    static constexpr size_t depth_buckets = 64;
+    std::uint64_t comparisons = 0;
+    std::uint64_t rotations = 0;
+    std::uint64_t recolourings = 0;
+    std::uint64_t fixup_iterations = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t lookups = 0;
+    std::uint64_t nodes_visited = 0;
+    std::uint64_t depth_histogram[depth_buckets] = {};
+
+    /**
+     @return the average number of nodes visited per lookup
+     */
+    double average_visited() const { return lookups ? static_cast<double>(nodes_visited) / lookups : 0.0; }
+};
+
+/**
+ the default instrumentation policy of rbt: counts nothing, and every hook is an empty inline call on an empty handle, so it compiles away
+ */
+struct rbt_no_stats
+{
+    /**
+     what the tree and its nodes call at each counted event
+     */
+    struct handle
+    {
+        static constexpr bool enabled = false;
+        void compare() const { }
+        void rotate() const { }
+        void recolour() const { }
+        void fixup() const { }
+        void allocate() const { }
+        void visit() const { }
+        void lookup_done(size_t) const { }
+    };
+    handle stats_handle() const { return handle(); }
+
+    /**
+     @return all zero counters
+     */
+    rbt_stats stats() const { return rbt_stats(); }
+    void reset_stats() { }
+};
+
+/**
+ the instrumentation policy that counts, use it as rbt<T, compare_type, rbt_count_stats>
+ */
+class rbt_count_stats
+{
+private:
+    mutable rbt_stats counters; // counted from const lookups too
+public:
+    struct handle
+    {
+        static constexpr bool enabled = true;
+        rbt_stats* counters;
+        void compare() const { ++counters->comparisons; }
+        void rotate() const { ++counters->rotations; }
+        void recolour() const { ++counters->recolourings; }
+        void fixup() const { ++counters->fixup_iterations; }
+        void allocate() const { ++counters->allocations; }
+        void visit() const { ++counters->nodes_visited; }
+        void lookup_done(size_t depth) const
+        {
+            ++counters->lookups;
+            ++counters->depth_histogram[depth < rbt_stats::depth_buckets ? depth : rbt_stats::depth_buckets - 1];
+        }
+    };
+    handle stats_handle() const { return handle{ &counters }; }
+
+    /**
+     @return a copy of the counters
+     */
+    rbt_stats stats() const { return counters; }
+
+    /**
+     set every counter back to zero
+     */
+    void reset_stats() { counters = rbt_stats(); }
+};
+
+/**
+ the shape of an rbt, as measured by rbt::health in one pass
+ height is the number of nodes on the longest path from the root down, 0 when empty
+ black_height is the number of black nodes on the path from the root to the leftmost leaf, counting the root
+ average_depth is the mean number of nodes from the root to each node, the root itself at depth 1
+ */
+struct rbt_health
+{
+    size_t nodes = 0;
+    size_t height = 0;
+    size_t black_height = 0;
+    double average_depth = 0.0;
+};
+
+/**
+ the balancing policies of rbt, each keeps one byte of balance information in every node and restores its shape after updates
+ a policy is a set of static functions on the tree's nodes, which it reaches through left, right, parent and balance,
+ rotations through left_rotate and right_rotate, and changes to balance through set_balance so they are counted as recolourings
+ insert_fixup runs after a new node with balance leaf() is linked in, erase_fixup after a node is unlinked,
+ where x took the place of the node that was physically removed, x_parent is its parent and removed was that node's balance
+ check and path_weight are used by rbt::validate, the rest describe a node's balance for print, dump_dot and dump_json
+ */
+
+/**
+ red-black balancing, the default: cheap updates with at most two rotations per insert and three per erase, and a height of up to 2 log n
+ balance is 1 for red and 0 for black
+ */
+struct rbt_red_black
+{
+    static const char* name() { return "red-black"; }
+    static unsigned char leaf() { return 1; } // new nodes are red
+    static unsigned char built(bool red, size_t) { return red ? 1 : 0; } // a node of a tree built from sorted values
+
+    template< typename Node >
+    static bool is_red(const Node* n) { return n != nullptr && n->balance == 1; }
+
+    template< typename Node, typename Stats >
+    static void insert_fixup(Node* n, Stats stats)
+    {
+        // n is red, the only possible problem is a red parent
+        while (is_red(n->parent))
+        {
+            stats.fixup();
+            Node* parent = n->parent;
+            Node* grandparent = parent->parent; // never null, the root is black
+            const bool parent_on_left = parent == grandparent->left;
+            Node* uncle = parent_on_left ? grandparent->right : grandparent->left;
+            if (is_red(uncle)) // push the red up to the grandparent and look again from there
+            {
+                parent->set_balance(0, stats);
+                uncle->set_balance(0, stats);
+                grandparent->set_balance(1, stats);
+                n = grandparent;
+                continue;
+            }
+            if (parent_on_left != (n == parent->left)) // n is an inner grandchild, turn it into an outer one
+            {
+                if (parent_on_left) { parent->left_rotate(stats); }
+                else { parent->right_rotate(stats); }
+                std::swap(n, parent);
+            }
+            parent->set_balance(0, stats);
+            grandparent->set_balance(1, stats);
+            if (parent_on_left) { grandparent->right_rotate(stats); }
+            else { grandparent->left_rotate(stats); }
+            break;
+        }
+        if (n->parent == nullptr) { n->set_balance(0, stats); } // the root is always black
+    }
+
+    template< typename Node, typename Stats >
+    static void erase_fixup(Node* x, Node* x_parent, unsigned char removed, Stats stats)
+    {
+        if (removed == 1) { return; } // removing a red node changes no black count
+        // a missing child counts as black; x carries an extra black that is pushed up or absorbed by a rotation
+        while (x_parent != nullptr && !is_red(x))
+        {
+            stats.fixup();
+            const bool on_left = x == x_parent->left;
+            Node* sibling = on_left ? x_parent->right : x_parent->left;
+            if (is_red(sibling)) // make the sibling black by rotating it above the parent
+            {
+                sibling->set_balance(0, stats);
+                x_parent->set_balance(1, stats);
+                if (on_left) { x_parent->left_rotate(stats); }
+                else { x_parent->right_rotate(stats); }
+                sibling = on_left ? x_parent->right : x_parent->left;
+            }
+            Node* near_nephew = on_left ? sibling->left : sibling->right;
+            Node* far_nephew = on_left ? sibling->right : sibling->left;
+            if (!is_red(near_nephew) && !is_red(far_nephew)) // take a black from both sides and move the extra black up
+            {
+                sibling->set_balance(1, stats);
+                x = x_parent;
+                x_parent = x->parent;
+                continue;
+            }
+            if (!is_red(far_nephew)) // turn the near red nephew into the far one
+            {
+                near_nephew->set_balance(0, stats);
+                sibling->set_balance(1, stats);
+                if (on_left) { sibling->right_rotate(stats); }
+                else { sibling->left_rotate(stats); }
+                sibling = on_left ? x_parent->right : x_parent->left;
+                far_nephew = on_left ? sibling->right : sibling->left;
+            }
+            // rotate the sibling above the parent, the far nephew's red becomes the missing black
+            sibling->set_balance(x_parent->balance, stats);
+            x_parent->set_balance(0, stats);
+            far_nephew->set_balance(0, stats);
+            if (on_left) { x_parent->left_rotate(stats); }
+            else { x_parent->right_rotate(stats); }
+            return;
+        }
+        if (x != nullptr) { x->set_balance(0, stats); }
+    }
+
+    template< typename Node >
+    static bool check(const Node* n, std::string& problem)
+    {
+        if (n->balance > 1) { problem = "node with colour byte " + std::to_string(n->balance); return false; }
+        if (n->parent == nullptr && n->balance == 1) { problem = "root is red"; return false; }
+        if (is_red(n) && (is_red(n->left) || is_red(n->right))) { problem = "red node with a red child"; return false; }
+        return true;
+    }
+
+    static size_t path_weight(unsigned char balance) { return balance == 1 ? 0 : 1; } // every path has the same number of black nodes
+    static const char* field() { return "color"; }
+    static void write_tag(std::ostream& out, unsigned char balance) { out << (balance == 1 ? "(r)" : "(b)"); }
+    static void write_json(std::ostream& out, unsigned char balance) { out << (balance == 1 ? "\"red\"" : "\"black\""); }
+    static bool highlighted(unsigned char balance) { return balance == 1; }
+};
+
+/**
+ AVL balancing: the two subtrees of every node differ in height by at most one, so the height stays under 1.44 log n,
+ which makes lookups shallower than red-black, at the price of more rotations and height updates per erase
+ balance is the height of the node's subtree, 1 for a leaf
+ */
+struct rbt_avl
+{
+    static const char* name() { return "avl"; }
+    static unsigned char leaf() { return 1; }
+    static unsigned char built(bool, size_t height) { return static_cast<unsigned char>(height); }
+
+    template< typename Node >
+    static int height(const Node* n) { return n != nullptr ? n->balance : 0; }
+
+    /**
+     set the height of n from its children
+     */
+    template< typename Node, typename Stats >
+    static void update(Node* n, Stats stats)
+    {
+        const int tallest = height(n->left) > height(n->right) ? height(n->left) : height(n->right);
+        n->set_balance(static_cast<unsigned char>(tallest + 1), stats);
+    }
+
+    /**
+     restore the balance of n, whose children are balanced and differ in height by at most two
+     @return the node now at the top of n's subtree
+     */
+    template< typename Node, typename Stats >
+    static Node* rebalance(Node* n, Stats stats)
+    {
+        update(n, stats);
+        const int skew = height(n->left) - height(n->right);
+        if (skew > 1)
+        {
+            Node* child = n->left;
+            if (height(child->left) < height(child->right)) // the inner grandchild is taller, rotate it out first
+            {
+                child->left_rotate(stats);
+                update(child, stats);
+            }
+            n->right_rotate(stats);
+        }
+        else if (skew < -1)
+        {
+            Node* child = n->right;
+            if (height(child->right) < height(child->left))
+            {
+                child->right_rotate(stats);
+                update(child, stats);
+            }
+            n->left_rotate(stats);
+        }
+        else { return n; }
+        update(n, stats);
+        update(n->parent, stats);
+        return n->parent;
+    }
+
+    /**
+     rebalance from n to the root, stopping once a subtree's height is unchanged
+     */
+    template< typename Node, typename Stats >
+    static void retrace(Node* n, Stats stats)
+    {
+        while (n != nullptr)
+        {
+            stats.fixup();
+            const unsigned char before = n->balance;
+            Node* top = rebalance(n, stats);
+            if (top == n && top->balance == before) { return; } // nothing above can change
+            n = top->parent;
+        }
+    }
+
+    template< typename Node, typename Stats >
+    static void insert_fixup(Node* n, Stats stats) { retrace(n->parent, stats); }
+
+    template< typename Node, typename Stats >
+    static void erase_fixup(Node*, Node* x_parent, unsigned char, Stats stats) { retrace(x_parent, stats); }
+
+    template< typename Node >
+    static bool check(const Node* n, std::string& problem)
+    {
+        const int left = height(n->left), right = height(n->right);
+        if (n->balance != (left > right ? left : right) + 1) { problem = "node with a stale height"; return false; }
+        if (left - right > 1 || right - left > 1) { problem = "subtree heights differ by more than one"; return false; }
+        return true;
+    }
+
+    static size_t path_weight(unsigned char) { return 0; }
+    static const char* field() { return "height"; }
+    static void write_tag(std::ostream& out, unsigned char balance) { out << '(' << static_cast<int>(balance) << ')'; }
+    static void write_json(std::ostream& out, unsigned char balance) { out << static_cast<int>(balance); }
+    static bool highlighted(unsigned char) { return false; }
+};
+
+/**
+ weak AVL balancing (Haeupler, Sen and Tarjan): built only by inserts it is an AVL tree, while erase does at most two rotations
+ like red-black, so it sits between the two, with a height under 1.44 log m for m inserts and under 2 log n always
+ balance is the rank of the node: 0 for a leaf, a missing child has rank -1,
+ and a child's rank is one or two less than its parent's
+ */
+struct rbt_wavl
+{
+    static const char* name() { return "wavl"; }
+    static unsigned char leaf() { return 0; }
+    static unsigned char built(bool, size_t height) { return static_cast<unsigned char>(height - 1); }
+
+    template< typename Node >
+    static int rank(const Node* n) { return n != nullptr ? n->balance : -1; }
+
+    template< typename Node, typename Stats >
+    static void promote(Node* n, int by, Stats stats) { n->set_balance(static_cast<unsigned char>(n->balance + by), stats); }
+
+    template< typename Node, typename Stats >
+    static void insert_fixup(Node* x, Stats stats)
+    {
+        // x may have the same rank as its parent, a 0-child, which is fixed by promotions up the tree and then at most two rotations
+        Node* p = x->parent;
+        while (p != nullptr && rank(p) == rank(x))
+        {
+            stats.fixup();
+            const bool on_left = x == p->left;
+            Node* sibling = on_left ? p->right : p->left;
+            if (rank(p) - rank(sibling) == 1) // promoting the parent makes x a 1-child and the sibling a 2-child
+            {
+                promote(p, 1, stats);
+                x = p;
+                p = p->parent;
+                continue;
+            }
+            Node* inner = on_left ? x->right : x->left;
+            if (rank(x) - rank(inner) == 2) // single rotation
+            {
+                if (on_left) { p->right_rotate(stats); }
+                else { p->left_rotate(stats); }
+                promote(p, -1, stats);
+            }
+            else // the inner child is a 1-child, double rotation brings it to the top
+            {
+                if (on_left) { x->left_rotate(stats); p->right_rotate(stats); }
+                else { x->right_rotate(stats); p->left_rotate(stats); }
+                promote(inner, 1, stats);
+                promote(x, -1, stats);
+                promote(p, -1, stats);
+            }
+            return;
+        }
+    }
+
+    template< typename Node, typename Stats >
+    static void erase_fixup(Node* x, Node* p, unsigned char, Stats stats)
+    {
+        if (p == nullptr) { return; }
+        if (p->left == nullptr && p->right == nullptr && p->balance == 1) // a leaf must have rank 0
+        {
+            promote(p, -1, stats);
+            x = p;
+            p = p->parent;
+        }
+        // x may now be a 3-child, fixed by demotions up the tree and then at most two rotations
+        while (p != nullptr && rank(p) - rank(x) == 3)
+        {
+            stats.fixup();
+            const bool on_left = x == p->left;
+            Node* sibling = on_left ? p->right : p->left;
+            if (rank(p) - rank(sibling) == 2) // demoting the parent makes both children fit
+            {
+                promote(p, -1, stats);
+                x = p;
+                p = p->parent;
+                continue;
+            }
+            Node* inner = on_left ? sibling->left : sibling->right;
+            Node* outer = on_left ? sibling->right : sibling->left;
+            if (rank(sibling) - rank(inner) == 2 && rank(sibling) - rank(outer) == 2) // the sibling is 2,2, demote it along with the parent
+            {
+                promote(sibling, -1, stats);
+                promote(p, -1, stats);
+                x = p;
+                p = p->parent;
+                continue;
+            }
+            if (rank(sibling) - rank(outer) == 1) // single rotation
+            {
+                if (on_left) { p->left_rotate(stats); }
+                else { p->right_rotate(stats); }
+                promote(sibling, 1, stats);
+                promote(p, -1, stats);
+                if (p->left == nullptr && p->right == nullptr) { promote(p, -1, stats); } // it became a leaf, which has rank 0
+            }
+            else // double rotation brings the inner nephew to the top
+            {
+                if (on_left) { sibling->right_rotate(stats); p->left_rotate(stats); }
+                else { sibling->left_rotate(stats); p->right_rotate(stats); }
+                promote(inner, 2, stats);
+                promote(sibling, -1, stats);
+                promote(p, -2, stats);
+            }
+            return;
+        }
+    }
+
+    template< typename Node >
+    static bool check(const Node* n, std::string& problem)
+    {
+        const int left = rank(n) - rank(n->left), right = rank(n) - rank(n->right);
+        if (left < 1 || left > 2 || right < 1 || right > 2) { problem = "child whose rank is not one or two below its parent's"; return false; }
+        if (n->left == nullptr && n->right == nullptr && n->balance != 0) { problem = "leaf with a rank other than 0"; return false; }
+        return true;
+    }
+
+    static size_t path_weight(unsigned char) { return 0; }
+    static const char* field() { return "rank"; }
+    static void write_tag(std::ostream& out, unsigned char balance) { out << '(' << static_cast<int>(balance) << ')'; }
+    static void write_json(std::ostream& out, unsigned char balance) { out << static_cast<int>(balance); }
+    static bool highlighted(unsigned char) { return false; }
+};
+
+/**
+ the link surgery rbt and intrusive_rbt share, written once over the link type: rbt's node or rbt_hook
+ a link has left, right, parent and balance, and the root's parent is nullptr
+ */
+struct rbt_links
+{
+    /**
+     rotate left about a link, its right child takes its place; only changes connections
+     @param n is the link, which must have a right child
+     @param stats is where the rotation is counted
+     */
+    template< typename Link, typename Stats >
+    static void rotate_left(Link* n, Stats stats);
+
+    /**
+     rotate right about a link, its left child takes its place; only changes connections
+     @param n is the link, which must have a left child
+     @param stats is where the rotation is counted
+     */
+    template< typename Link, typename Stats >
+    static void rotate_right(Link* n, Stats stats);
+
+    /**
+     find the in-order successor by following links only
+     @return the next larger link, nullptr if n is the largest
+     */
+    template< typename Link >
+    static Link* successor(Link* n);
+
+    /**
+     find the in-order predecessor by following links only
+     @return the next smaller link, nullptr if n is the smallest
+     */
+    template< typename Link >
+    static Link* predecessor(Link* n);
+
+    /**
+     put one subtree in the place of another under the other's parent, updating root if needed
+     @param root is the tree's root
+     @param old_link is the subtree to replace
+     @param new_link is the subtree that takes its place, can be nullptr
+     */
+    template< typename Link >
+    static void transplant(Link*& root, Link* old_link, Link* new_link);
+
+    /**
+     take a link out of its tree and let the balance_policy restore the balance; the link itself is left for the caller to free or reset
+     @param root is the tree's root
+     @param leftmost is the tree's smallest link
+     @param rightmost is the tree's largest link
+     @param doomed is the link to take out
+     @param stats is where the fixup's work is counted
+     */
+    template< typename balance_policy, typename Link, typename Stats >
+    static void unlink(Link*& root, Link*& leftmost, Link*& rightmost, Link* doomed, Stats stats);
+
+    /**
+     Check the parent links, the order, the size and the balance_policy's own rules in one in-order walk with an explicit stack
+     @param root is the tree's root, not nullptr
+     @param size is how many links the tree says it has
+     @param in_order is called with two neighbouring links and returns true if the first one's value is smaller
+     @param problem is set to a description of the first broken invariant
+     @return true if the tree is valid
+     */
+    template< typename balance_policy, typename Link, typename In_order >
+    static bool validate(const Link* root, size_t size, In_order in_order, std::string& problem);
+};
+
+template< typename Link, typename Stats >
+void rbt_links::rotate_left(Link* n, Stats stats)
+{
+    stats.rotate();
+    Link* up = n->right; // the right child takes n's place
+    up->parent = n->parent;
+    if (n->parent != nullptr) // if there is a parent, not root
+    {
+        if (n->parent->left == n) { n->parent->left = up; }
+        else { n->parent->right = up; }
+    }
+    n->right = up->left; // its left subtree moves under n
+    if (n->right != nullptr) { n->right->parent = n; }
+    up->left = n;
+    n->parent = up;
+}
+
+template< typename Link, typename Stats >
+void rbt_links::rotate_right(Link* n, Stats stats)
+{
+    stats.rotate();
+    Link* up = n->left; // the left child takes n's place
+    up->parent = n->parent;
+    if (n->parent != nullptr) // if there is a parent, not root
+    {
+        if (n->parent->left == n) { n->parent->left = up; }
+        else { n->parent->right = up; }
+    }
+    n->left = up->right; // its right subtree moves under n
+    if (n->left != nullptr) { n->left->parent = n; }
+    up->right = n;
+    n->parent = up;
+}
+
+template< typename Link >
+Link* rbt_links::successor(Link* n)
+{
+    if (n->right != nullptr) // if something is on the right, the next one is the farthest left of it
+    {
+        n = n->right;
+        while (n->left != nullptr) { n = n->left; }
+        return n;
+    }
+    // otherwise climb until coming up from a left child, that parent is the next one
+    while (n->parent != nullptr && n == n->parent->right) { n = n->parent; }
+    return n->parent; // null if this is the largest
+}
+
+template< typename Link >
+Link* rbt_links::predecessor(Link* n)
+{
+    if (n->left != nullptr) // if something is on the left, the previous one is the farthest right of it
+    {
+        n = n->left;
+        while (n->right != nullptr) { n = n->right; }
+        return n;
+    }
+    // otherwise climb until coming up from a right child, that parent is the previous one
+    while (n->parent != nullptr && n == n->parent->left) { n = n->parent; }
+    return n->parent; // null if this is the smallest
+}
+
+template< typename Link >
+void rbt_links::transplant(Link*& root, Link* old_link, Link* new_link)
+{
+    if (old_link->parent == nullptr) { root = new_link; }
+    else if (old_link == old_link->parent->left) { old_link->parent->left = new_link; }
+    else { old_link->parent->right = new_link; }
+    if (new_link != nullptr) { new_link->parent = old_link->parent; }
+}
+
+template< typename balance_policy, typename Link, typename Stats >
+void rbt_links::unlink(Link*& root, Link*& leftmost, Link*& rightmost, Link* doomed, Stats stats)
+{
+    // the neighbour of an extreme is one or two links away, since the extreme has no child on its outer side
+    if (doomed == leftmost) { leftmost = successor(doomed); }
+    if (doomed == rightmost) { rightmost = predecessor(doomed); }
+    // x is the link that moves into the place a link left, and x_parent its new parent, since x can be nullptr
+    Link* x = nullptr;
+    Link* x_parent = nullptr;
+    unsigned char removed = doomed->balance; // the balance of the link whose place is given up
+    if (doomed->left == nullptr || doomed->right == nullptr) // at most one child, which takes its place
+    {
+        x = doomed->left != nullptr ? doomed->left : doomed->right;
+        x_parent = doomed->parent;
+        transplant(root, doomed, x);
+    }
+    else // two children, the successor link itself is moved into its place, keeping the colour of the place
+    {
+        Link* next = doomed->right;
+        while (next->left != nullptr) { next = next->left; }
+        removed = next->balance;
+        x = next->right;
+        if (next->parent == doomed) { x_parent = next; }
+        else
+        {
+            x_parent = next->parent;
+            transplant(root, next, next->right);
+            next->right = doomed->right;
+            next->right->parent = next;
+        }
+        transplant(root, doomed, next);
+        next->left = doomed->left;
+        next->left->parent = next;
+        next->balance = doomed->balance; // it also takes over the colour, height or rank of the place
+    }
+    balance_policy::erase_fixup(x, x_parent, removed, stats);
+    if (root != nullptr) { while (root->parent != nullptr) { root = root->parent; } } // rotations only ever move the root down by one parent link
+}
+
+template< typename balance_policy, typename Link, typename In_order >
+bool rbt_links::validate(const Link* root, size_t size, In_order in_order, std::string& problem)
+{
+    if (root->parent != nullptr) { problem = "root has a parent"; return false; }
+
+    // each entry is a link and the path weight above it, which is the number of black links for red-black
+    std::vector< std::pair<const Link*, size_t> > pending;
+    const Link* previous = nullptr;
+    size_t expected_weight = 0; // the weight of every root to leaf path, set at the first leaf
+    bool seen_leaf = false;
+    size_t count = 0;
+
+    // push a link and its left spine, checking every link on the way down
+    auto descend = [&](const Link* current, size_t weight_above) -> bool
+    {
+        while (true)
+        {
+            if (!balance_policy::check(current, problem)) { return false; }
+            const size_t weight = weight_above + balance_policy::path_weight(current->balance);
+            for (const Link* child : { current->left, current->right })
+            {
+                if (child == nullptr)
+                {
+                    if (!seen_leaf) { expected_weight = weight; seen_leaf = true; }
+                    else if (weight != expected_weight) { problem = "paths with " + std::to_string(weight) + " and " + std::to_string(expected_weight) + " black nodes"; return false; }
+                }
+                else if (child->parent != current) { problem = "child whose parent link points elsewhere"; return false; }
+            }
+            pending.emplace_back(current, weight_above);
+            if (current->left == nullptr) { return true; }
+            weight_above = weight;
+            current = current->left;
+        }
+    };
+
+    if (!descend(root, 0)) { return false; }
+    while (!pending.empty())
+    {
+        const Link* current = pending.back().first;
+        const size_t weight = pending.back().second + balance_policy::path_weight(current->balance);
+        pending.pop_back();
+        if (previous != nullptr && !in_order(previous, current)) { problem = "values out of order"; return false; }
+        previous = current;
+        ++count;
+        if (current->right != nullptr && !descend(current->right, weight)) { return false; }
+    }
+    if (count != size) { problem = std::to_string(count) + " nodes but size " + std::to_string(size); return false; }
+    return true;
+}
 
 /**
  @tparam T is the data stored in the rbt
  @tparam compare_type is the rule to compare node values (of type T)
+ @tparam stats_policy is rbt_no_stats (the default, no cost) or rbt_count_stats to count what the tree does, read with stats()
+ @tparam balance_policy is rbt_red_black (the default, cheapest updates), rbt_avl (shallowest lookups) or rbt_wavl (in between)
+ @tparam inline_nodes is how many nodes live inside the tree object before nodes come from the heap, 0 by default
  node is the nested class
  root is a pointer to a node, initialzed to nullptr
  pred is the correspoding compare_type
  tree_size records the number of elements in the tree
 */
-template< typename T, typename compare_type = std::less< T > >
+template< typename T, typename compare_type = std::less< T >, typename stats_policy = rbt_no_stats, typename balance_policy = rbt_red_black, size_t inline_nodes = 0 >
 class rbt;
 
 /**
- non-member swap functionthat stays outside of pic10c namespace
- @param tree1 is the "left hand side" rbt
- @param tree2 is the "right hand side" rbt
-*/
-template< typename T, typename compare_type >
-void swap(rbt<T, compare_type>& tree1, rbt<T, compare_type>& tree2) { tree1.swap(tree2); }
+ non-member swap functionthat stays outside of pic10c namespace
+ @param tree1 is the "left hand side" rbt
+ @param tree2 is the "right hand side" rbt
+*/
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void swap(rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>& tree1, rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>& tree2) { tree1.swap(tree2); }
+
+/**
+ describes how a value of type T is written into and read back from an rbt image
+ the primary template handles trivially copyable types by copying their bytes, which also lets images of them be memory-mapped
+ specialize it to store other types
+ @tparam T is the data stored in the rbt
+ */
+template< typename T >
+struct rbt_serializer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "rbt_serializer must be specialized for types that are not trivially copyable");
+    static constexpr bool is_raw = true; // values are stored as sizeof(T) raw bytes
+    static void write(std::ostream& out, const T& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    static T read(std::istream& in)
+    {
+        T value;
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+    static void write_text(std::ostream& out, const T& value) { out << value << '\n'; } // one value per line
+    static T read_text(std::istream& in)
+    {
+        T value{};
+        in >> value;
+        return value;
+    }
+};
+
+/**
+ specialization for strings, each value is stored as a 64-bit length followed by its characters
+ */
+template< typename Char, typename Traits, typename Alloc >
+struct rbt_serializer< std::basic_string<Char, Traits, Alloc> >
+{
+    using string_type = std::basic_string<Char, Traits, Alloc>;
+    static constexpr bool is_raw = false;
+    static void write(std::ostream& out, const string_type& value)
+    {
+        const std::uint64_t len = value.size();
+        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.write(reinterpret_cast<const char*>(value.data()), len * sizeof(Char));
+    }
+    static string_type read(std::istream& in)
+    {
+        std::uint64_t len = 0;
+        in.read(reinterpret_cast<char*>(&len), sizeof(len));
+        string_type value(in ? len : 0, Char());
+        in.read(reinterpret_cast<char*>(&value[0]), value.size() * sizeof(Char));
+        return value;
+    }
+    static void write_text(std::ostream& out, const string_type& value) { out << value << '\n'; } // one string per line, so strings must not hold newlines
+    static string_type read_text(std::istream& in)
+    {
+        string_type value;
+        std::getline(in, value);
+        return value;
+    }
+};
+
+/**
+ ranks overloads so the first matching one wins, rbt_priority<N> converts to every lower priority
+ */
+template< unsigned N > struct rbt_priority : rbt_priority< N - 1 > { };
+template<> struct rbt_priority<0> { };
+
+/**
+ describes how rbt compares two values with one call that tells less, equal and greater apart
+ it is chosen at compile time, in this order:
+ 1. the comparator's own compare(a, b), returning negative, zero or positive
+ 2. for std::less and std::greater, the value's compare(b), as std::string has
+ 3. for std::less and std::greater in C++20, the value's operator<=>, unless it is a built-in arithmetic type where one < is as cheap
+ when none applies, enabled is false and rbt walks down with one pred per level, checking for equality once at the bottom
+ specialize it to give a comparator a three-way form
+ @tparam T is the data stored in the rbt
+ @tparam compare_type is the rbt's comparator
+ */
+template< typename T, typename compare_type >
+struct rbt_three_way
+{
+private:
+    template< typename C >
+    struct is_less : std::integral_constant<bool, std::is_same<C, std::less<T>>::value || std::is_same<C, std::less<void>>::value> { };
+    template< typename C >
+    struct is_greater : std::integral_constant<bool, std::is_same<C, std::greater<T>>::value || std::is_same<C, std::greater<void>>::value> { };
+
+    using by_comparator = std::integral_constant<int, 1>;
+    using by_member = std::integral_constant<int, 2>;
+    using by_spaceship = std::integral_constant<int, 3>;
+    using by_pred = std::integral_constant<int, 0>;
+
+    template< typename C >
+    static auto pick(rbt_priority<3>, const C* p) -> decltype(static_cast<int>(p->compare(std::declval<const T&>(), std::declval<const T&>())), by_comparator());
+    template< typename C, typename V = T >
+    static auto pick(rbt_priority<2>, const C*) -> typename std::enable_if<is_less<C>::value || is_greater<C>::value,
+        decltype(static_cast<int>(std::declval<const V&>().compare(std::declval<const V&>())), by_member())>::type;
+#if __cplusplus >= 202002L
+    template< typename C, typename V = T >
+    static auto pick(rbt_priority<1>, const C*) -> typename std::enable_if<(is_less<C>::value || is_greater<C>::value)
+        && !std::is_arithmetic<V>::value && std::three_way_comparable<V>, by_spaceship>::type;
+#endif
+    static by_pred pick(rbt_priority<0>, const void*);
+
+    using kind = decltype(pick(rbt_priority<3>(), static_cast<const compare_type*>(nullptr)));
+
+    static int sign(int r) { return (r > 0) - (r < 0); }
+    static int compare(by_comparator, const compare_type& pred, const T& a, const T& b) { return sign(static_cast<int>(pred.compare(a, b))); }
+    static int compare(by_member, const compare_type&, const T& a, const T& b)
+    {
+        const int r = sign(static_cast<int>(a.compare(b)));
+        return is_greater<compare_type>::value ? -r : r;
+    }
+#if __cplusplus >= 202002L
+    static int compare(by_spaceship, const compare_type&, const T& a, const T& b)
+    {
+        const auto c = a <=> b;
+        const int r = (c > 0) - (c < 0);
+        return is_greater<compare_type>::value ? -r : r;
+    }
+#endif
+    static int compare(by_pred, const compare_type& pred, const T& a, const T& b) { return pred(a, b) ? -1 : (pred(b, a) ? 1 : 0); } // two calls
+
+public:
+    static constexpr bool enabled = kind::value != 0; // false when comparing costs two calls to pred
+
+    /**
+     compare two values in the comparator's order
+     @return -1 if a goes before b, 1 if it goes after, 0 if they are equivalent
+     */
+    static int compare(const compare_type& pred, const T& a, const T& b) { return compare(kind(), pred, a, b); }
+};
+
+/**
+ the type of the key key_of_value gives a T
+ */
+template< typename T, typename key_of_value >
+using rbt_key_type = typename std::decay<decltype(std::declval<const key_of_value&>()(std::declval<const T&>()))>::type;
+
+/**
+ a key_of_value that takes one member of a record as its key
+ @tparam T is the record type
+ @tparam K is the member's type
+ @tparam member is the member
+ */
+template< typename T, typename K, K T::*member >
+struct rbt_member_key
+{
+    const K& operator()(const T& record) const { return record.*member; }
+};
+
+/**
+ a compare_type that orders records by a key taken from each of them, so an rbt can store whole records and be searched by key
+ anything compared that is not a T is taken to be a key already, and the comparator is transparent,
+ so rbt's find and erase take a key directly and never build a record to search with
+ when the keys have a three-way form (see rbt_three_way), the records get one too
+ @tparam T is the record type stored in the rbt
+ @tparam key_of_value gives the key of a record, called as key_of_value(record)
+ @tparam key_compare is the rule to compare keys
+ */
+template< typename T, typename key_of_value, typename key_compare = std::less< rbt_key_type<T, key_of_value> > >
+struct rbt_key_compare
+{
+    using key_type = rbt_key_type<T, key_of_value>;
+    using is_transparent = void;
+    key_of_value key_of;
+    key_compare compare_keys;
+
+    explicit rbt_key_compare(const key_of_value& _key_of = key_of_value(), const key_compare& _compare_keys = key_compare()) : key_of(_key_of), compare_keys(_compare_keys) { }
+
+    /**
+     compare two records, two keys, or a record and a key, by key
+     @return true if a goes before b
+     */
+    template< typename A, typename B >
+    bool operator()(const A& a, const B& b) const { return compare_keys(key(a), key(b)); }
+
+    /**
+     compare two records by key in one step, only when the keys have a three-way form
+     @return -1 if a goes before b, 1 if it goes after, 0 if their keys are equivalent
+     */
+    template< typename K = key_type >
+    typename std::enable_if<rbt_three_way<K, key_compare>::enabled, int>::type compare(const T& a, const T& b) const
+    {
+        return rbt_three_way<K, key_compare>::compare(compare_keys, key_of(a), key_of(b));
+    }
+
+private:
+    auto key(const T& record) const -> decltype(std::declval<const key_of_value&>()(record)) { return key_of(record); }
+    template< typename K, typename = typename std::enable_if<!std::is_same<K, T>::value>::type >
+    const K& key(const K& k) const { return k; }
+};
+
+/**
+ an rbt of records ordered and searched by a key taken from each record, see rbt_key_compare
+ e.g. rbt_keyed<employee, rbt_member_key<employee, int, &employee::id>> holds employees and finds them with find(id)
+ */
+template< typename T, typename key_of_value, typename key_compare = std::less< rbt_key_type<T, key_of_value> >,
+    typename stats_policy = rbt_no_stats, typename balance_policy = rbt_red_black, size_t inline_nodes = 0 >
+using rbt_keyed = rbt<T, rbt_key_compare<T, key_of_value, key_compare>, stats_policy, balance_policy, inline_nodes>;
+
+/**
+ the index arithmetic of the Eytzinger layout rbt::frozen and rbt_const_set keep their values in:
+ slot 1 is the root, the children of slot i are slots 2i and 2i + 1, and slot 0 means no slot
+ each function is one expression so it can run at compile time even in C++11
+ */
+struct rbt_eytzinger
+{
+    /**
+     @return the slot of the smallest value in the subtree at slot, out of count slots
+     */
+    static constexpr size_t first_below(size_t slot, size_t count) { return 2 * slot <= count ? first_below(2 * slot, count) : slot; }
+
+    /**
+     @return the slot of the smallest of count values, 0 if there are none
+     */
+    static constexpr size_t first(size_t count) { return count == 0 ? 0 : first_below(1, count); }
+
+    /**
+     climb while coming up from a right child, then once more; this also finishes a lower bound search that walked off the bottom
+     @return the first ancestor the slot is on the left of, 0 if there is none
+     */
+    static constexpr size_t up_from_right(size_t slot) { return (slot & 1) ? up_from_right(slot >> 1) : slot >> 1; }
+
+    /**
+     @return the slot of the value after the one at slot, out of count slots, 0 past the largest
+     */
+    static constexpr size_t next(size_t slot, size_t count) { return 2 * slot + 1 <= count ? first_below(2 * slot + 1, count) : up_from_right(slot); }
+};
+
+/**
+ room for the first N nodes of an rbt inside the tree object, so a tree that never holds more than N values never allocates
+ freed slots go on a free list linked by index through the slots themselves, so taking and giving back a slot is O(1);
+ a freed slot is handed out again before the heap is used, so a tree that shrinks goes back to inline nodes as it is refilled,
+ while the nodes it still has stay where they are and iterators to them stay valid
+ rbt::node is still incomplete where this is needed, so a slot is sized by a struct with the same members
+ @tparam T is the data stored in the rbt
+ @tparam N is the number of slots
+ */
+template< typename T, size_t N >
+class rbt_node_slab
+{
+protected:
+    struct slot { T value; void* links[3]; unsigned char balance; }; // the layout of rbt::node
+
+    rbt_node_slab() = default;
+    rbt_node_slab(const rbt_node_slab&) = delete; // nodes are relocated one by one, never copied as bytes
+    rbt_node_slab& operator=(const rbt_node_slab&) = delete;
+
+    /**
+     @return the memory of slot i
+     */
+    void* slab_at(size_t i) { return slots + i * sizeof(slot); }
+
+    /**
+     @return true if slot i holds a node
+     */
+    bool slab_used(size_t i) const { return (used[i / 64] >> (i % 64)) & 1; }
+
+    /**
+     @return how many slots have ever been handed out, the slots past it were never touched
+     */
+    size_t slab_extent() const { return extent; }
+
+    /**
+     claim a free slot, the one freed last or else one never used
+     @return its memory, or nullptr if every slot is taken
+     */
+    void* slab_take()
+    {
+        size_t i = free_head;
+        if (i != N) { std::memcpy(&free_head, slab_at(i), sizeof(free_head)); } // a free slot holds the index of the next one
+        else if (extent < N) { i = extent++; }
+        else { return nullptr; }
+        used[i / 64] |= std::uint64_t(1) << (i % 64);
+        return slab_at(i);
+    }
+
+    /**
+     give slot i back, its node must already be destroyed
+     */
+    void slab_release(size_t i)
+    {
+        used[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+        std::memcpy(slab_at(i), &free_head, sizeof(free_head));
+        free_head = i;
+    }
+
+    /**
+     @return the slot p is in, or N if it is not in the slab
+     */
+    size_t slab_index(const void* p) const
+    {
+        // compare as integers, pointers into different objects are not ordered
+        const std::uintptr_t at = reinterpret_cast<std::uintptr_t>(p), first = reinterpret_cast<std::uintptr_t>(slots);
+        return at >= first && at < first + N * sizeof(slot) ? (at - first) / sizeof(slot) : N;
+    }
+
+    /**
+     take over which slots another slab uses and its free list; the nodes themselves are moved by the caller
+     @param other is the slab to copy the state of
+     */
+    void slab_copy_state(rbt_node_slab& other)
+    {
+        std::memcpy(used, other.used, sizeof(used));
+        free_head = other.free_head;
+        extent = other.extent;
+        for (size_t i = 0; i < extent; ++i)
+        {
+            if (!slab_used(i)) { std::memcpy(slab_at(i), other.slab_at(i), sizeof(size_t)); } // the free list link
+        }
+    }
+
+    /**
+     forget every slot, after their nodes were destroyed or moved away
+     */
+    void slab_reset()
+    {
+        std::memset(used, 0, sizeof(used));
+        free_head = N;
+        extent = 0;
+    }
+
+private:
+    alignas(slot) unsigned char slots[N * sizeof(slot)];
+    std::uint64_t used[(N + 63) / 64] = {}; // bit i is set while slot i holds a node
+    size_t free_head = N; // the last freed slot, N when the free list is empty
+    size_t extent = 0;
+};
+
+/**
+ without inline slots every node comes from the heap and the tree object stays as small as before
+ */
+template< typename T >
+class rbt_node_slab<T, 0>
+{
+protected:
+    struct slot { T value; void* links[3]; unsigned char balance; };
+    void* slab_at(size_t) { return nullptr; }
+    bool slab_used(size_t) const { return false; }
+    size_t slab_extent() const { return 0; }
+    void* slab_take() { return nullptr; }
+    void slab_release(size_t) { }
+    size_t slab_index(const void*) const { return 0; }
+    void slab_copy_state(rbt_node_slab&) { }
+    void slab_reset() { }
+};
+
+/**
+ the fixed header at the front of every rbt image, padded to 64 bytes so the values behind it stay aligned
+ magic and version identify the format, count is the number of values stored in sorted order after the header
+ version 1 also stored a colour bit per value after the values; version 2 drops it, since load works the colours out from the count
+ */
+struct rbt_image_header
+{
+    static constexpr std::uint32_t current_version = 2;
+    char magic[8]; // always "rbtimage"
+    std::uint32_t version;
+    std::uint32_t raw; // 1 if values are stored as raw bytes
+    std::uint32_t value_size; // sizeof(T) for raw images, 0 otherwise
+    std::uint32_t value_align; // alignof(T) for raw images, 0 otherwise
+    std::uint64_t count;
+    char padding[32];
+};
+static_assert(sizeof(rbt_image_header) == 64, "rbt_image_header must stay 64 bytes");
 
+/**
+ the formats rbt can stream its values in
+ binary is the magic "rbtstrm1", a 64-bit count, then each value as written by rbt_serializer::write
+ text is the count on the first line, then each value as written by rbt_serializer::write_text
+ */
+enum class rbt_format { binary, text };
 
-template< typename T, typename compare_type >
-class rbt
+/**
+ a stream buffer that moves data to or from a file descriptor or another stream buffer in large chunks
+ used for one direction only: either write through it with an ostream, or read through it with an istream
+ */
+class rbt_stream_buffer : public std::streambuf
+{
+public:
+    static constexpr size_t default_chunk = size_t(1) << 20; // 1 MiB per read or write
+
+#if RBT_POSIX
+    /**
+     constructor over a file descriptor, the descriptor is not closed
+     @param _fd is the file descriptor
+     @param chunk is the size of each read or write
+     */
+    explicit rbt_stream_buffer(int _fd, size_t chunk = default_chunk) : fd(_fd), buffer(chunk ? chunk : 1) { setp(buffer.data(), buffer.data() + buffer.size()); }
+#endif
+
+    /**
+     constructor over another stream buffer, which gets whole chunks at a time
+     @param _target is the stream buffer to forward to
+     @param chunk is the size of each write
+     */
+    explicit rbt_stream_buffer(std::streambuf* _target, size_t chunk = default_chunk) : target(_target), buffer(chunk ? chunk : 1) { setp(buffer.data(), buffer.data() + buffer.size()); }
+
+    rbt_stream_buffer(const rbt_stream_buffer&) = delete;
+    rbt_stream_buffer& operator=(const rbt_stream_buffer&) = delete;
+
+    /**
+     destructor, writes out whatever is still buffered
+     */
+    ~rbt_stream_buffer() { sync(); }
+
+protected:
+    /**
+     the put area is full, write it out and start again
+     */
+    int_type overflow(int_type ch) override
+    {
+        if (!flush_chunk()) { return traits_type::eof(); }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) { *pptr() = traits_type::to_char_type(ch); pbump(1); }
+        return traits_type::not_eof(ch);
+    }
+
+    /**
+     write out what is buffered
+     */
+    int sync() override
+    {
+        if (!flush_chunk()) { return -1; }
+        if (target != nullptr) { return target->pubsync(); }
+        return 0;
+    }
+
+    /**
+     the get area is empty, read the next chunk
+     */
+    int_type underflow() override
+    {
+        if (gptr() < egptr()) { return traits_type::to_int_type(*gptr()); }
+        std::streamsize got = 0;
+        if (target != nullptr) { got = target->sgetn(buffer.data(), static_cast<std::streamsize>(buffer.size())); }
+#if RBT_POSIX
+        else
+        {
+            ssize_t n;
+            do { n = ::read(fd, buffer.data(), buffer.size()); } while (n < 0 && errno == EINTR);
+            got = n > 0 ? n : 0;
+        }
+#endif
+        if (got <= 0) { return traits_type::eof(); }
+        setg(buffer.data(), buffer.data(), buffer.data() + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    int fd = -1;
+    std::streambuf* target = nullptr;
+    std::vector<char> buffer;
+
+    /**
+     write the put area out in one go
+     @return false if the write failed
+     */
+    bool flush_chunk()
+    {
+        const char* data = pbase();
+        std::streamsize left = pptr() - pbase();
+        while (left > 0)
+        {
+            std::streamsize n = 0;
+            if (target != nullptr) { n = target->sputn(data, left); }
+#if RBT_POSIX
+            else
+            {
+                n = ::write(fd, data, static_cast<size_t>(left));
+                if (n < 0 && errno == EINTR) { continue; }
+            }
+#endif
+            if (n <= 0) { return false; }
+            data += n;
+            left -= n;
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return true;
+    }
+};
+
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt : private stats_policy, private rbt_node_slab<T, inline_nodes>
 {
 private:
+    using stats_handle_type = typename stats_policy::handle;
+    using three_way = rbt_three_way<T, compare_type>; // how walks down the tree compare, chosen at compile time
     /**
      the definition of ndoe class, which is nexted within rbt
      value is the valued  stored in the node of type T
-     pred is the comparing mechanism for the nodes' values
      left, right, parent all all points to its left-child node, right-child node, and parent-node correspondingly
      */
     class node;
     node* root = nullptr;
+    node* leftmost = nullptr; // the smallest node, kept up to date so begin() is O(1)
+    node* rightmost = nullptr; // the largest node, which --end() reaches in O(1)
     compare_type pred;
     size_t tree_size = 0;
+
+    /**
+     find the smallest and largest nodes again after the tree was built some other way than link and unlink
+     */
+    void reset_extremes();
     
     /**
      Insert a node traversely, until it finds it position
@@ -46,13 +1233,143 @@ private:
     */
     void traverse_insert(node* start);
 
+    /**
+     make a node in a free inline slot, or on the heap when every slot is taken
+     @param args are passed to the node's constructor
+     @return the node
+     */
+    template< typename... Args >
+    node* make_node(Args&&... args);
+
+    /**
+     destroy a node and give back its inline slot or its heap memory
+     @param doomed is the node
+     */
+    void free_node(node* doomed);
+
+    /**
+     take over the whole tree of another rbt, which is left empty; this tree must be empty
+     nodes in the other tree's inline slots are moved into the same slots here, and every link to them is updated
+     @param other is the tree to take from
+     */
+    void adopt(rbt& other);
+
+    /**
+     Link a new node into the tree and rebalance, or free it if its value is already in the tree
+     @param new_node is the node, with the balance_policy's balance for a new leaf
+     */
+    void link(node* new_node);
+
     /**
      Traversely delete nodes from a position, and every nodes below that position. Currently, this is not color-fitted, so only called when deleting the entire tree (destructor)
      @param start is the node to below which everything are removed
     */
     void traverse_delete(node* start);
 
-    
+    /**
+     unlink a node from the tree, free it, and let the balance_policy restore the balance
+     @param doomed is the node to remove
+     */
+    void unlink(node* doomed);
+
+    /**
+     Build a balanced subtree from values handed out in sorted order, in linear time and without any comparisons
+     the deepest level is coloured red, which is the only level that can be incomplete, so every path has the same black height;
+     the balance_policy turns that colour and the subtree's height into each node's balance
+     @tparam Source is called as source(red) for each value in order and returns it, red holds the computed colour and may be overwritten
+     @param source hands out the values
+     @param count is how many values go in this subtree
+     @param parent is the node the subtree hangs from
+     @param depth is the depth of the subtree's root
+     @param red_depth is the deepest level of the whole tree
+     @return the root of the subtree, nullptr if count is 0
+     @throws whatever source throws, after freeing the nodes this call built
+     */
+    template< typename Source >
+    node* build_sorted(Source& source, size_t count, node* parent, size_t depth, size_t red_depth);
+
+    /**
+     build_sorted trusts the order it is given, so what it built from a file or stream is checked with one pass over neighbours
+     @return true if every value is smaller than the next
+     */
+    bool strictly_increasing() const;
+
+    /**
+     the deepest level of the balanced tree build_sorted makes from count values
+     @param count is how many values are in the tree
+     @return floor(log2(count)), 0 for an empty tree
+     */
+    static size_t sorted_depth(size_t count);
+
+    /**
+     after a rotation the old root may have moved down, walk back up so root is the real root again
+     */
+    void fix_root();
+
+    /**
+     find the first node not smaller than value, one walk down from the root
+     @tparam K is T, or a key type the comparator is transparent for
+     @param value is the value to look for
+     @return the node, or nullptr if every value is smaller
+     */
+    template< typename K >
+    node* lower_bound_node(const K& value) const;
+
+    /**
+     find the node equivalent to value, one walk down from the root
+     @param value is the value to look for
+     @return the node, or nullptr if there is none
+     */
+    node* find_node(const T& value) const;
+
+    /**
+     find the node whose value is equivalent to a key, the lower bound and one more comparison
+     @param key is the key to look for
+     @return the node, or nullptr if there is none
+     */
+    template< typename K >
+    node* find_key_node(const K& key) const;
+
+    /**
+     @return the node holding the largest value, nullptr for an empty tree
+     */
+    node* largest_node() const;
+
+    /**
+     Stream count values starting at first, in the given format, through a chunked buffer over out
+     @param out is where the values go
+     @param first is the node of the first value
+     @param count is how many values to write
+     @param format is binary or text
+     @param chunk is how many bytes are buffered between writes
+     */
+    void write_run(std::streambuf* out, node* first, size_t count, rbt_format format, size_t chunk) const;
+
+    /**
+     write a value as a quoted string, escaping what would end the string in DOT or JSON
+     @param out is the stream to write to
+     @param value is the value, written with operator<<
+     @param scratch is reused to format the value
+     */
+    static void write_quoted(std::ostream& out, const T& value, std::ostringstream& scratch);
+
+    /**
+     write an arithmetic value as a JSON literal: bool as true or false, character types as their code,
+     and a NaN or infinity, which JSON cannot hold, as null
+     @param out is the stream to write to
+     @param value is the value
+     */
+    static void write_json_value(std::ostream& out, const T& value, std::ostringstream&, std::true_type);
+
+    /**
+     write any other value as a JSON string made with operator<<
+     @param out is the stream to write to
+     @param value is the value
+     @param scratch is reused to format the value
+     */
+    static void write_json_value(std::ostream& out, const T& value, std::ostringstream& scratch, std::false_type) { write_quoted(out, value, scratch); }
+
+
 public:
     /**
      default constructor of rbt
@@ -70,13 +1387,9 @@ public:
      move constructor of rbt
      @param obj is another rbt
      */
-    rbt(rbt&& obj) noexcept : rbt()
+    rbt(rbt&& obj) noexcept : rbt(obj.pred)
     {
-        using std::swap;
-        swap(root, obj.root);
-        swap(pred, obj.pred);
-        swap(tree_size, obj.tree_size);
-        obj.root = nullptr; // remove the other rbt after swapping
+        adopt(obj); // obj is left empty
     }      //move constructor
     
     /**
@@ -91,39 +1404,52 @@ public:
     */
     rbt& operator=(rbt other) &
     {
-        rbt temp = copy(other); // calls the copy constructor
-        using std::swap;
-        swap(root, temp.root);
-        swap(pred, temp.pred);
-        swap(tree_size, temp.tree_size);
+        swap(other); // other is already a copy, and takes the old tree away with it
+        return *this;
     }
     
     /**
      the definition of iterator class, which is nexted within rbt
      this node is the node that iterator pointing to
-     container is the rbt tree that iterator belongs to
-     pred is the comparing type for the templated T values passed in
+     container is the rbt tree that iterator belongs to, which holds the only copy of the comparator
      */
     class iterator; // nested iterator class
     
     class const_iterator;
     
     /**
-     find the begin iterator of a tree, which is the smallest position
+     find the begin iterator of a tree, which is the smallest position, in O(1) from the cached smallest node
     @return an iterator to the begin() or smallest of the rbt
     */
     iterator begin(); // begin() "smallest" of the rbt
     const_iterator begin() const;
     
     /**
-     the end means "past the end" iterator, which always points to null
+     the end means "past the end" iterator, which always points to null; decrementing it gives the largest value
     @return an iterator to the end() or largest of the rbt
     */
     iterator end(); // end() "largest" of the rbt
     const_iterator end() const;
     
+    /**
+     find the largest position in O(1), from the cached largest node
+    @return an iterator to the largest value, end() if the tree is empty
+    */
     iterator largest();
     const_iterator largest() const;
+
+    /**
+     remove the smallest value and return it, for using the tree as a priority queue;
+     the smallest node has no left child and is found in O(1), and red-black rebalancing after it is amortised O(1)
+    @return the value that was smallest
+    */
+    T pop_min();
+
+    /**
+     remove the largest value and return it
+    @return the value that was largest
+    */
+    T pop_max();
     
     /**
      insert function for rbt, attempts to insert a value of templated T type (l-value)
@@ -142,46 +1468,63 @@ public:
      @param other is a node to identify in rbt
      @return if found, return its iterator; if not found, return the null iterator
     */
-    iterator find(const node& other)
-    {
-        // simply go through each element to return the corresponding iterator, if not found ,returne null iterator
-        iterator current = begin();
-        // as long as not reaching the end, do so recurssively
-        while (current != end())
-        {
-            // directly return the iterator if found matching value
-            if (current.this_node->get_node_val() == other.value) { return current; }
-            // keep doing while, nothing special if vvalue not matching
-            else { ++current; }
-        }
-        return iterator(nullptr, this);
-    }
+    iterator find(const node& other) { return find(other.value); }
     
     /**
-     locate a value in the rbt structure
+     locate a value in the rbt structure with one walk down the tree, one comparison per level when the comparator has a
+     three-way form (see rbt_three_way) and one per level plus one at the bottom otherwise
      @param value is a node to identify in rbt
      @return if found, return its iterator; if not found, return the null iterator
     */
-    iterator find(const T& value)
-    {
-        // simply go through each element to return the corresponding iterator, if not found ,returne null iterator
-        iterator current = begin();
-        // as long as not reaching the end, do so recurssively
-        while (current != end())
-        {
-            // directly return the iterator if found matching value
-            if (current.this_node->get_node_val() == value) { return current; }
-            // keep doing while, nothing special if vvalue not matching
-            else { ++current; }
-        }
-        return iterator(nullptr, this);
-    }
+    iterator find(const T& value) { return iterator(find_node(value), this); }
+
+    /**
+     locate the value equivalent to a key, without making a T to search with; only when the comparator is transparent,
+     as rbt_key_compare is, so records can be looked up by their key
+     @tparam K is the key type, anything the comparator can compare with a T
+     @param key is the key to look for
+     @return if found, return its iterator; if not found, return the null iterator
+    */
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    iterator find(const K& key) { return iterator(find_key_node(key), this); }
+
+    /**
+     locate a value in a const tree, see find(const T&) and find(const K&)
+     @param value is the value or key to look for
+     @return if found, return its iterator; if not found, return the null iterator
+    */
+    const_iterator find(const T& value) const { return const_iterator(find_node(value), this); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    const_iterator find(const K& key) const { return const_iterator(find_key_node(key), this); }
+
+    /**
+     find the first value not smaller than the given one, or than a key when the comparator is transparent
+     @param value is the value or key to look for
+     @return its iterator, or end() if every value is smaller
+    */
+    iterator lower_bound(const T& value) { return iterator(lower_bound_node(value), this); }
+    const_iterator lower_bound(const T& value) const { return const_iterator(lower_bound_node(value), this); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    iterator lower_bound(const K& key) { return iterator(lower_bound_node(key), this); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    const_iterator lower_bound(const K& key) const { return const_iterator(lower_bound_node(key), this); }
     
     /**
      find the size of the rbt
      @return a positive integer or 0 indicating the number of nodes of the rbt
      */
-    const size_t size() { return tree_size; }
+    size_t size() const { return tree_size; }
+
+    /**
+     a snapshot of the instrumentation counters, all zero unless stats_policy is rbt_count_stats
+     @return the counters
+     */
+    using stats_policy::stats;
+
+    /**
+     set the instrumentation counters back to zero
+     */
+    using stats_policy::reset_stats;
     
     /**
      member emplace function that inputs the given arguments into the templated type and put into rbt
@@ -191,10 +1534,36 @@ public:
     void emplace(Args&&... values); // member emplace function
     
     /**
-     erase function for rbt, given an iterator
+     erase function for rbt, given an iterator; the node is unlinked and the tree relinked around it, no value is copied or moved,
+     so iterators to every other node stay valid
     @param iter is an iterator to identify in the rbt
+    @return an iterator to the value after the erased one, or end()
+     */
+    iterator erase(iterator iter); //erase a specific iterator
+
+    /**
+     erase the value equal to the given one, if there is one, found with one walk down the tree
+     @param value is the value to remove
+     @return the number of values removed, 0 or 1
      */
-    void erase(iterator iter); //erase a specific iterator
+    size_t erase(const T& value);
+
+    /**
+     erase the value equivalent to a key, if there is one, only when the comparator is transparent
+     @tparam K is the key type, anything the comparator can compare with a T
+     @param key is the key of the value to remove
+     @return the number of values removed, 0 or 1
+     */
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    size_t erase(const K& key);
+
+    /**
+     erase every value in [first, last); erasing the whole tree frees it in one pass without rebalancing
+     @param first is the first value to remove
+     @param last is the first value to keep
+     @return last
+     */
+    iterator erase(iterator first, iterator last);
     
     /**
     A member version of swap function to swap current rbt with the given one
@@ -206,30 +1575,197 @@ public:
      Find how many steps from the start it takes to reach the current node, now only using start as root.
      @param start is the starting point to calculate height
      @param target is the ending point
-     @param cumulated_height is a number passed into the function so that it calls recurssively, always first start from 0!
-     @return an integer, indicating length from start to target
+     @param cumulated_height is added to the result, always first start from 0!
+     @return an integer, indicating length from start to target, or -1 if target is not below start
      */
     const int node_depth(node* start, node* target, int cumulated_height);
     
     /**
-     The function used to print the structure of the tree
+     The function used to print the structure of the tree, sideways with the largest value on top, in one O(n) pass
      */
     void print();
+
+    /**
+     Write the shape of the tree as a Graphviz digraph, one pre-order pass through a chunked buffer
+     a subtree cut off by a limit is drawn as a "..." node under its parent
+     @param out is the stream to write to
+     @param max_depth is the deepest level written, the root is at depth 1
+     @param max_nodes is the most nodes written
+     */
+    void dump_dot(std::ostream& out, size_t max_depth = size_t(-1), size_t max_nodes = size_t(-1)) const;
+
+    /**
+     Write the shape of the tree as nested JSON objects with value, the balance_policy's field (color, height or rank), left and right, one pass through a chunked buffer
+     arithmetic values are written as numbers (character types by their code, NaN and infinity as null, bool as true or false),
+     anything else as a string made with operator<<;
+     a node with a child cut off by a limit has "truncated": true
+     @param out is the stream to write to
+     @param max_depth is the deepest level written, the root is at depth 1
+     @param max_nodes is the most nodes written
+     */
+    void dump_json(std::ostream& out, size_t max_depth = size_t(-1), size_t max_nodes = size_t(-1)) const;
+
+    /**
+     Check every invariant of the tree in one O(n) pass that allocates only a stack as deep as the tree:
+     values in strictly increasing order, parent links that match child links, a node count equal to size(), and the balance_policy's rules:
+     for red-black a black root, no red node with a red child and the same number of black nodes on every path,
+     for AVL correct heights that differ by at most one between siblings, for WAVL rank differences of one or two and leaves of rank 0
+     @param problem is set to a description of the first broken invariant, left alone if there is none
+     @return true if the tree is valid
+     */
+    bool validate(std::string& problem) const;
+
+    /**
+     Check every invariant of the tree, see validate(std::string&)
+     @return true if the tree is valid
+     */
+    bool validate() const;
+
+    /**
+     Measure the shape of the tree in one O(n) pass
+     @return the node count, height, black-height and average depth
+     */
+    rbt_health health() const;
+
+    /**
+     Write the tree to a file as a compact, versioned image: a header, then the values in sorted order
+     the image holds no pointers, so it can be loaded or mapped at any address
+     @param path is the file to write, replaced if it exists
+     */
+    void save(const std::string& path) const;
+
+    /**
+     Replace the contents of the tree with an image written by save, rebuilding it in linear time; the colours are worked
+     out again rather than read, and values out of order are rejected, so a damaged image cannot make an invalid tree
+     @param path is the file to read
+     */
+    void load(const std::string& path);
+
+#if RBT_POSIX
+    /**
+     a read-only view of an image of trivially copyable values, mapped into memory and searched in place without deserialising
+     */
+    class mapped;
+
+    /**
+     Map an image written by save for read-only use, on POSIX systems
+     @param path is the file to map
+     @param _pred is the compare type the image was sorted with
+     @return the mapped view of the image
+     */
+    static mapped map(const std::string& path, const compare_type& _pred = compare_type());
+#endif
+
+    /**
+     an immutable copy of the values in one array, in Eytzinger (breadth-first) order, searched without branches or pointers
+     */
+    class frozen;
+
+    /**
+     Copy the tree into a frozen, read-optimised array in one O(n) pass; frozen::thaw turns it back into an rbt
+     @return the frozen copy, the tree is left unchanged
+     */
+    frozen freeze() const;
+
+    /**
+     a lazy view over the values in [lo, hi), in increasing order or, when reversed, decreasing order
+     it holds two node pointers, so making and walking it never allocates; changing the tree invalidates it
+     */
+    template< bool reversed >
+    class basic_range;
+    using range_view = basic_range<false>;
+    using reverse_range_view = basic_range<true>;
+
+    /**
+     View the values in [lo, hi) in increasing order, found with one walk down the tree
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @return the view, empty if hi is not larger than lo
+     */
+    range_view range(const T& lo, const T& hi) const;
+
+    /**
+     View the values in [lo, hi) in decreasing order
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @return the view, empty if hi is not larger than lo
+     */
+    reverse_range_view reverse_range(const T& lo, const T& hi) const;
+
+    /**
+     Stream the whole tree out in sorted order, buffering it into large chunks
+     @param out is the stream to write to
+     @param format is binary or text
+     @param chunk is how many bytes are buffered between writes
+     */
+    void write_sorted(std::ostream& out, rbt_format format = rbt_format::binary, size_t chunk = rbt_stream_buffer::default_chunk) const;
+
+#if RBT_POSIX
+    /**
+     Stream the whole tree out in sorted order to a file descriptor, buffering it into large chunks
+     @param fd is the file descriptor to write to, it is not closed
+     @param format is binary or text
+     @param chunk is how many bytes are buffered between writes
+     */
+    void write_sorted(int fd, rbt_format format = rbt_format::binary, size_t chunk = rbt_stream_buffer::default_chunk) const;
+#endif
+
+    /**
+     Stream the values in [lo, hi) out in sorted order, in the same format as write_sorted so read_sorted can take it back
+     @param out is the stream to write to
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @param format is binary or text
+     @param chunk is how many bytes are buffered between writes
+     */
+    void write_range(std::ostream& out, const T& lo, const T& hi, rbt_format format = rbt_format::binary, size_t chunk = rbt_stream_buffer::default_chunk) const;
+
+#if RBT_POSIX
+    /**
+     Stream the values in [lo, hi) out in sorted order to a file descriptor
+     @param fd is the file descriptor to write to, it is not closed
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @param format is binary or text
+     @param chunk is how many bytes are buffered between writes
+     */
+    void write_range(int fd, const T& lo, const T& hi, rbt_format format = rbt_format::binary, size_t chunk = rbt_stream_buffer::default_chunk) const;
+#endif
+
+    /**
+     Replace the contents of the tree with sorted values streamed in by write_sorted or write_range, building it in linear time
+     only one value is held at a time, the input must be strictly increasing
+     @param in is the stream to read from
+     @param format is binary or text
+     */
+    void read_sorted(std::istream& in, rbt_format format = rbt_format::binary);
+
+#if RBT_POSIX
+    /**
+     Replace the contents of the tree with sorted values streamed in from a file descriptor
+     @param fd is the file descriptor to read from, it is not closed
+     @param format is binary or text
+     @param chunk is how many bytes are read at a time
+     */
+    void read_sorted(int fd, rbt_format format = rbt_format::binary, size_t chunk = rbt_stream_buffer::default_chunk);
+#endif
 };
 
-template< typename T, typename compare_type >
-class rbt<T, compare_type>::node
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node
 {
     friend rbt; // made friend so rbt and iterator types can access the node values, etc
     friend iterator;
     friend const_iterator;
+    template< bool reversed > friend class basic_range;
+    friend balance_policy;
+    friend rbt_links;
 private:
     T value;
-    compare_type pred;
     node* left; // left child
     node* right; // right child
     node* parent; // parent node
-    std::string color; // color of the node
+    unsigned char balance; // the balance_policy's information: the colour, height or rank of the node
     
     /**
     default constructor of the node class, no parameter, default point things to nullptr
@@ -239,21 +1775,25 @@ private:
     /**
      construct node given its value, but has no specified left, right, nor parent
     @param val is a variable of type T
+    @param _balance is the balance information the policy gives it
     */
-    node(T val, std::string col);
+    node(T val, unsigned char _balance);
 public:
     /**
      the public method to get node value
-     @return the value stored in the node
+     @return a reference to the value stored in the node
      */
-    const T get_node_val() const { return value; }
+    const T& get_node_val() const { return value; }
     
     /**
-     insert node function for node, trying to insert at the node's right and left, if not empty, then do so recursively
+     insert node function for node, walking down from this node to the empty child the new node belongs in
     @param new_node is a pointer to a node is
     @param _pred is the cooreponding compare type for values
+    @param stats is where comparisons and visits are counted
+    @param depth is how many nodes were visited above this one
+    @return true if the node was linked in, false if its value was a duplicate and the node was left for the caller to free
     */
-    void insert_node(node* new_node, compare_type _pred); // insert node at node member function
+    bool insert_node(node* new_node, const compare_type& _pred, stats_handle_type stats, size_t depth = 0); // insert node at node member function
     
     /**
      find what kind of child the current node has
@@ -263,13 +1803,15 @@ public:
     
     /**
      rotate left about the current node, only changes connection
+     @param stats is where the rotation is counted
      */
-    void left_rotate();
+    void left_rotate(stats_handle_type stats) { rbt_links::rotate_left(this, stats); }
     
     /**
      rotate right about the current node, only changes connection
+     @param stats is where the rotation is counted
      */
-    void right_rotate();
+    void right_rotate(stats_handle_type stats) { rbt_links::rotate_right(this, stats); }
     
     /**
      find whether this node is the left child of the parent, right child of parent, or the root
@@ -281,23 +1823,34 @@ public:
      find the sibling of the node
      @return a pointer to this node's sibling, can be a nullptr if the node doesn't have a sibling
      */
-    node* find_node_sibling();
-    
+    node* find_node_sibling();
+
+    /**
+     find the in-order successor by following pointers only
+     @return the next larger node, nullptr if this is the largest
+     */
+    node* successor() { return rbt_links::successor(this); }
+
     /**
-     helper function to correct coloring during erase, starting from this node
+     find the in-order predecessor by following pointers only
+     @return the next smaller node, nullptr if this is the smallest
      */
-    void correct_color_erase();
+    node* predecessor() { return rbt_links::predecessor(this); }
     
     /**
-     helper function to correct coloring during insert, starting from this node
-     @param new_node_pos is whether during inserting, the new node is trying to be inserted to this node's left or right
+     set the balance information of this node, counting it as a recolouring if it changes
+     @param _balance is the new colour, height or rank
+     @param stats is where the recolouring is counted
      */
-    void correct_color_insert(std::string new_node_pos);
+    void set_balance(unsigned char _balance, stats_handle_type stats)
+    {
+        if (balance != _balance) { stats.recolour(); balance = _balance; }
+    }
 }; // end of node class
 
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::traverse_insert(node* start)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::traverse_insert(node* start)
 {
     // only insert when not starting from null
     if (start!=nullptr)
@@ -309,133 +1862,120 @@ void rbt<T, compare_type>::traverse_insert(node* start)
         // if there are something on the right, go start recurssively from there
         if (start->right != nullptr) { traverse_insert(start->right); }
     }
-    // if starting from null, throw error
-    else { throw; }
+    // starting from null is copying an empty tree, there is nothing to insert
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::traverse_delete(node* start)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::traverse_delete(node* start)
 {
     // only works when not starting from null
-    if (start != nullptr) {
-        // if something is on the left, first go delete there
-        if ( (start->left) != nullptr ) { traverse_delete(start->left); }
-        // if something is on the right, first go delete there
-        if ( (start->right) != nullptr ) { traverse_delete(start->right); }
-        --tree_size;
-        start = nullptr;
-        delete start;
+    if (start == nullptr) { return; }
+    if (start->parent != nullptr) // detach the subtree first
+    {
+        if (start->parent->left == start) { start->parent->left = nullptr; }
+        else { start->parent->right = nullptr; }
     }
-    // if starting from null, throw error
-    else { throw; }
+    start->parent = nullptr;
+    // free the subtree bottom up without recursion: descend to a leaf, free it, then continue from its parent
+    node* current = start;
+    while (current != nullptr)
+    {
+        if (current->left != nullptr) { current = current->left; }
+        else if (current->right != nullptr) { current = current->right; }
+        else
+        {
+            node* up = current->parent;
+            if (up != nullptr)
+            {
+                if (up->left == current) { up->left = nullptr; }
+                else { up->right = nullptr; }
+            }
+            free_node(current);
+            --tree_size;
+            current = up;
+        }
+    }
+    if (start == root) { root = leftmost = rightmost = nullptr; }
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator rbt<T, compare_type>::largest()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::largest()
 {
-    if (root == nullptr) { return iterator(nullptr, this); } // if there is no rrot return nullptr, else go to next line
-    iterator iter = iterator(root, this);
-    while (iter.this_node->right != nullptr) { iter.this_node = iter.this_node->right; } // always go the farthest right and return the iterator
-    return iter;
+    return iterator(rightmost, this); // nullptr when the tree is empty
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator rbt<T, compare_type>::largest() const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::largest() const
 {
-    if (root == nullptr) { return const_iterator(nullptr, this); } // if there is no rrot return nullptr, else go to
-    const_iterator iter = const_iterator(root, this);
-    while (iter.this_node->right != nullptr) { iter.this_node = iter.this_node->right; } // always go the farthest right and return the iterator
-    return iter;
+    return const_iterator(rightmost, this); // nullptr when the tree is empty
 }
 
-template< typename T, typename compare_type >
-template < typename... Args >
-void rbt<T, compare_type>::emplace(Args&&... values)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::link(node* new_node)
 {
-    // create a new node with the correct type, first initialze to unknown color
-    node* new_node = new node(T(std::forward< Args > (values) ...), "unknown");
-
+    const stats_handle_type stats = this->stats_handle();
+    stats.allocate();
+    // the first node becomes the root, otherwise insert_node walks down from the root, and the node is freed if its value is a duplicate
+    if (root == nullptr) { root = leftmost = rightmost = new_node; }
+    else if (!root->insert_node(new_node, pred, stats)) { free_node(new_node); return; } // duplicates are not counted
+    // a new smallest or largest node always hangs directly off the old one
+    else if (new_node == leftmost->left) { leftmost = new_node; }
+    else if (new_node == rightmost->right) { rightmost = new_node; }
     ++tree_size;
-    // insert the new node into the tree
-    // insert to root if there isn't one yet
-    if (root == nullptr) { new_node->color = "black"; root = new_node; }
-    // if there is a root, insert_node called recurssively from there
-    else { new_node->color = "red"; root->insert_node(new_node, pred); }
-}
-
-template< typename T, typename compare_type >
-const int rbt<T, compare_type>::node_depth(node* current, node* target, int cumulated_height)
-{
-    const bool is_this = current->value == target->value; // if current node equals target node
-    const bool is_on_left = pred(target->value, current->value); // if target is on the left of current
-    const bool is_on_right = pred(current->value, target->value); // if target is on the right of current
-    
-    if (is_this) { return cumulated_height; } // return cumulated height until now
-    else if (is_on_left) { return node_depth(current->left, target, ++cumulated_height); } // add 1 to height, and to left
-    else if (is_on_right) { return node_depth(current->right, target, ++cumulated_height); } // add 1 to height, and to right
-    else { return -1; } // if none of these cases, return -1 as a special notation
+    balance_policy::insert_fixup(new_node, stats);
+    fix_root();
 }
 
-
-template< typename T, typename compare_type >
-const std::string rbt<T, compare_type>::node::find_its_child()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template < typename... Args >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::emplace(Args&&... values)
 {
-    std::string its_child;
-    if (left == nullptr && right == nullptr) { its_child = "none"; }
-    else if (left == nullptr && right != nullptr) { its_child = "right_only"; }
-    else if (left != nullptr && right == nullptr) { its_child = "left_only"; }
-    else { its_child = "both"; }
-    return its_child;
+    // create a new node with the correct type and the policy's balance for a new leaf, then insert it into the tree
+    link(make_node(T(std::forward< Args > (values) ...), balance_policy::leaf()));
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::node::left_rotate()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const int rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node_depth(node* current, node* target, int cumulated_height)
 {
-    right->parent = parent;
-    if (parent != nullptr) // if there is a parent, not root
+    // one three-way comparison per step, or one pred per step and a last one to tell target apart from a smaller value
+    node* candidate = nullptr;
+    int candidate_height = -1;
+    while (current != nullptr)
     {
-        if (parent->left != nullptr) // if parent's left is not nullptr
+        if (three_way::enabled)
         {
-            if (parent->left == this) { parent->left = right; } // if this is the left child of parent
-            else { parent->right = right; } // if this is the right child of parent
+            const int order = three_way::compare(pred, target->value, current->value);
+            if (order == 0) { return cumulated_height; } // return cumulated height until now
+            current = order < 0 ? current->left : current->right;
         }
-        else { parent->right = right; } // if parent's left is nullptr, then this must be the parent's right child
-    } // if target is root, do the following directly, no need figure out new parent
-    parent = right; // new parent is its old right child
-    if (right->left != nullptr) // find new right child if exist
-    {
-        right->left->parent = this;
-        right = right->left;
+        else if (pred(target->value, current->value)) { current = current->left; } // target is on the left of current
+        else
+        {
+            if (current == target) { return cumulated_height; }
+            candidate = current; // target is this node or on its right
+            candidate_height = cumulated_height;
+            current = current->right;
+        }
+        ++cumulated_height;
     }
-    else { right = nullptr; } // connect right child to null otherwise
-    parent->left = this;
+    if (candidate != nullptr && !pred(candidate->value, target->value)) { return candidate_height; } // an equal value, not the node itself
+    return -1; // if none of these cases, return -1 as a special notation
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::node::right_rotate()
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const std::string rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::find_its_child()
 {
-    left->parent = parent;
-    if (parent != nullptr) // if there is a parent, not root
-    {
-        if (parent->left != nullptr) // if parent's left is not nullptr
-        {
-            if (parent->left == this) { parent->left = left; } // if this is the left child of parent
-            else { parent->right = left; } // if this is the right child of parent
-        }
-        else { parent->right = left; } // if parent's left is nullptr, then this must be the parent's right child
-    } // if target is root, do the following directly, no need figure out new parent
-    parent = left;// new parent is its old right child
-    if (left->right != nullptr) // find new right child if exist
-    {
-        left->right->parent = this;
-        left = left->right;
-    }
-    else { left = nullptr; } // connect right child to null otherwise
-    parent->right = this;
+    std::string its_child;
+    if (left == nullptr && right == nullptr) { its_child = "none"; }
+    else if (left == nullptr && right != nullptr) { its_child = "right_only"; }
+    else if (left != nullptr && right == nullptr) { its_child = "left_only"; }
+    else { its_child = "both"; }
+    return its_child;
 }
 
-template< typename T, typename compare_type >
-const std::string rbt<T, compare_type>::node::find_node_position()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const std::string rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::find_node_position()
 {
     if (parent == nullptr) {  return "root"; } // parent is null means this node is root
     else if (parent->right == nullptr) {  return "left"; } // if parent's right is null, this node is left
@@ -444,8 +1984,8 @@ const std::string rbt<T, compare_type>::node::find_node_position()
     else { return "right"; } // not equal to left means must be right
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::node* rbt<T, compare_type>::node::find_node_sibling()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::find_node_sibling()
 {
     std::string node_position = find_node_position();
     if (node_position == "root") { return nullptr; } // root must have no sibling
@@ -453,187 +1993,13 @@ typename rbt<T, compare_type>::node* rbt<T, compare_type>::node::find_node_sibli
     else { return parent->left; } // right node has left sibling, may be null sibling
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::node::correct_color_erase()
-{
-    const std::string its_child = find_its_child(); // its_child is "none", "left_only", "right_only"| even if "both" happens, it is not meaningful!
-    
-    std::string node_position = find_node_position();
-    node* sibling = find_node_sibling();
-    std::string sibling_color = "black";
-    if (sibling != nullptr && sibling->color == "red") { sibling_color = "red"; } // sibling color is defaulted black, unless it has a non null red sibling
-    
-    node* left_child_of_sibling = sibling->left;
-    node* right_child_of_sibling = sibling->right;
-    std::string col_of_left_of_sibling = "black";
-    if (left_child_of_sibling != nullptr && left_child_of_sibling->color == "red") { col_of_left_of_sibling = "red"; } // color of left of sibling is defaulted black, unless it has a non null and red left of sibling
-    std::string col_of_right_of_sibling = "black";
-    if (right_child_of_sibling != nullptr && right_child_of_sibling->color == "red") { col_of_right_of_sibling = "red"; } // color of right of sibling is defaulted black, unless it has a non null and red right of sibling
-    
-    if (color == "double_black") // if there is a double black, run this part to "fix" it first!
-    {
-        if (node_position == "root") { color = "black"; } // if this is the node, guarantee to color it black
-        else if (sibling_color == "red" && node_position == "left") // red sibling means parent must be black
-        {
-            parent->color = "red";
-            parent->left_rotate();
-            correct_color_erase();
-        }
-        else if (sibling_color == "red" && node_position == "right") // red sibling means parent must be black
-        {
-            parent->color = "red";
-            parent->right_rotate();
-            correct_color_erase();
-        }
-        else if (sibling_color == "black" && node_position == "left") // black sibling, n is left child
-        {
-            if (col_of_left_of_sibling == "red" && col_of_right_of_sibling == "black") // sibling has left-child red, right-child black
-            {
-                using namespace std;
-                std::swap(sibling->color, left_child_of_sibling->color);
-                sibling->right_rotate();
-                correct_color_erase();
-            }
-            else if (col_of_right_of_sibling == "red") // sibling has right-child red, left-child any color
-            {
-                color = "black";
-                right_child_of_sibling->color = "black";
-                if (parent->color == "red") // parent is red, correct color and rotate
-                {
-                    sibling->color = "red";
-                    parent->color = "black";
-                }
-                else { } // parent is black, just need to rotate
-                parent->left_rotate();
-            }
-            else // color of both children of sibling are black
-            {
-                color = "black";
-                if (parent->color == "red") // parent is red, correct colors and done
-                {
-                    parent->color = "black";
-                    sibling->color = "red";
-                }
-                else // parent is black, correct color and call recurssively
-                {
-                    parent->color = "double_black";
-                    sibling->color = "red";
-                    parent->correct_color_erase();
-                }
-            }
-        }
-        else if (sibling_color == "black" && node_position == "right") // black sibling, n is right child
-        {
-            
-            if (col_of_left_of_sibling == "black" && col_of_right_of_sibling == "red") // sibling has one left black and one right red child
-            {
-                using namespace std;
-                std::swap(sibling->color, right_child_of_sibling->color);
-                sibling->left_rotate();
-                correct_color_erase();
-            }
-            else if (col_of_left_of_sibling == "red") // sibling has left red child (black is whatever child)
-            {
-                color = "black";
-                left_child_of_sibling->color = "black";
-                if (parent->color == "red") // IV, A
-                {
-                    sibling->color = "red";
-                    parent->color = "black";
-                }
-                else { } // IV, B
-                parent->right_rotate();
-            }
-            else // color of both children of sibling are black
-            {
-                color = "black";
-                if (parent->color == "red") // red parent, correct color
-                {
-                    parent->color = "black";
-                    sibling->color = "red";
-                }
-                else // black parent, correct based upon its parent
-                {
-                    parent->color = "double_black";
-                    sibling->color = "red";
-                    parent->correct_color_erase();
-                }
-            }
-        }
-    }
-    
-    if (its_child == "none") // if no child, just correct color and call recurssively
-    {
-        if (color == "red") { color = "black"; } // removal 2, red and no children
-        else // removal 3, black and no children
-        {
-            color = "double_black";
-            correct_color_erase();
-        }
-    }
-    else if (its_child == "right_only" && right->color == "red") { right->color = "black"; } // only right red child means color its right child black
-    else if (its_child == "left_only" && left->color == "red") { left->color = "black"; } // only left red child means color its left child black
-    else { } // if having both child, the erase method wouldn't do anything first but to swap values, and then call erase recurssively, so no need to correct their colors since not changing any connection
-}
-
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::node::correct_color_insert(std::string new_node_pos)
-{
-    node* new_node;
-    if (new_node_pos == "left") { new_node = left; }
-    else { new_node = right; } // find how to connect the new node to the original ones
-    
-    if (parent == nullptr) { color = "black"; } // if parent is null, this is root, color this to black
-    if (color == "black") { } // if inserting under black, need to do thing
-    else if (color == "red") // if inserting under red
-    {
-        std::string sibling_color = "black";
-        if (find_node_sibling() != nullptr && find_node_sibling()->color == "red") { sibling_color = "red"; }
-        // first find sibling color, which default to be black, underless sibling is not null and red
-        if (sibling_color == "red") // if has a red sibling, just correct the colors
-        {
-            parent->left->color = "black";
-            parent->right->color = "black";
-            parent->color = "red";
-            //parent->correct_color_insert(parent->find_node_position()); // correction upon grandparent
-        }
-        else // sibling is black
-        {
-            std::string pos = find_node_position();
-            if (new_node_pos == "left" && pos == "left") // if new node is append to left and this node is on the left of parent
-            {
-                color = "black";
-                parent->color = "red";
-                parent->right_rotate();
-            }
-            else if (new_node_pos == "right" && pos == "right") // if new node is append to right and this node is on the right of parent
-            {
-                color = "black";
-                parent->color = "red";
-                parent->left_rotate();
-            }
-            else if (new_node_pos == "right" && pos == "left") // if new node is append to right and this node is on the left of parent
-            {
-                left_rotate();
-                correct_color_insert(pos); // correction upon parent
-            }
-            else // if new node is append to left and this node is on the right of parent
-            {
-                right_rotate();
-                correct_color_insert(pos); // correction upon parent
-            }
-        }
-    }
-}
-
-template< typename T, typename compare_type >
-class rbt<T, compare_type>::iterator
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator
 {
     friend rbt; // made friend so rbt can access the iterator's functions and everything
 private:
     node* this_node; // the node that iterator points to
     const rbt* container; // the rbt the iterator belongs to
-    compare_type pred;
     iterator() : this_node(nullptr), container(nullptr) { } // default point to nullptrs
     iterator(node* other, const rbt* rbt) : this_node(other), container(rbt) { } // constructor given node and a tree
 public:
@@ -690,14 +2056,14 @@ public:
     /**
      overload double equal operator to find whether two iterators are the same
     @param other is the right hand side of the double equal operator
-    @return a bool type of whether this current rbt and the given are equal
+    @return whether both iterators point to the same node, which does not compare or copy the values
     */
     bool operator==(iterator other) const;
     
     /**
      overload not equal operator to find whether two iterators are not equal
     @param other is the right hand side of the not equal operator
-    @return a bool type of whether this current rbt and the given are not equal
+    @return whether the iterators point to different nodes
     */
     bool operator!=(iterator other) const;
     
@@ -708,14 +2074,13 @@ public:
     void print_iter_node(const std::string& depth_padding);
 }; // end of iterator class
 
-template< typename T, typename compare_type >
-class rbt<T, compare_type>::const_iterator
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator
 {
     friend rbt; // made friend so rbt can access the iterator's functions and everything
 private:
     node* this_node; // the node that iterator points to
     const rbt* container; // the rbt the iterator belongs to
-    compare_type pred;
     const_iterator() : this_node(nullptr), container(nullptr) { } // default point to nullptrs
     const_iterator(node* other, const rbt* rbt) : this_node(other), container(rbt) { } // constructor given node and a tree
 public:
@@ -772,14 +2137,14 @@ public:
     /**
      overload double equal operator to find whether two iterators are the same
     @param other is the right hand side of the double equal operator
-    @return a bool type of whether this current rbt and the given are equal
+    @return whether both iterators point to the same node, which does not compare or copy the values
     */
     bool operator==(const_iterator other) const;
     
     /**
      overload not equal operator to find whether two iterators are not equal
     @param other is the right hand side of the not equal operator
-    @return a bool type of whether this current rbt and the given are not equal
+    @return whether the iterators point to different nodes
     */
     bool operator!=(const_iterator other) const;
     
@@ -791,516 +2156,1158 @@ public:
 }; // end of const iterator class
 
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::swap(rbt& other)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::swap(rbt& other)
 {
-    // swapping the root, pred, and size are effectively swapping the trees
-    using std::swap;
-    swap(root, other.root);
-    swap(pred, other.pred);
-    swap(tree_size, other.tree_size);
+    // without inline nodes this only exchanges the roots, the cached extremes, pred, and size; inline nodes are moved across
+    rbt held(other.pred);
+    held.adopt(other);
+    other.adopt(*this);
+    adopt(held);
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::node* rbt<T, compare_type>::iterator::find_next_node() // find the node, whose value is the next larger one than the given node
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< typename... Args >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::make_node(Args&&... args)
 {
-    node* current_node = this_node;
-    if (current_node->right != nullptr)// if something is on the right, go to the next leftest node
-    {
-        current_node = current_node->right;
-        // keep going to the farthest left of the right
-        while (current_node->left != nullptr) { current_node = current_node->left; }
-        return current_node;
-    }
-    else // if nothing is on the right, then already at the largest value
+    using slot = typename rbt_node_slab<T, inline_nodes>::slot;
+    static_assert(sizeof(node) <= sizeof(slot) && alignof(node) <= alignof(slot), "rbt_node_slab::slot must have the layout of rbt::node");
+    void* place = this->slab_take();
+    if (place == nullptr) { return new node(std::forward<Args>(args)...); }
+    try { return new (place) node(std::forward<Args>(args)...); }
+    catch (...)
     {
-        std::string node_position = current_node->find_node_position();
-        // keep going to find whether this is coming from a left child
-        while (current_node->parent != nullptr)
-        {
-            if (node_position == "left") { return current_node->parent; } // came from left the return parent
-            else // otherwise keep going
-            {
-                current_node = current_node->parent;
-                node_position = current_node->find_node_position();
-            }
-        }
-        return nullptr; //return null is it is the largest
+        this->slab_release(this->slab_index(place));
+        throw;
     }
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::node* rbt<T, compare_type>::const_iterator::find_next_node() // find the node, whose value is the next larger one than the given node
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::free_node(node* doomed)
+{
+    const size_t i = this->slab_index(doomed);
+    if (i == inline_nodes) { delete doomed; return; } // a heap node
+    doomed->~node();
+    this->slab_release(i);
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::adopt(rbt& other)
 {
-    node* current_node = this_node;
-    if (current_node->right != nullptr)// if something is on the right, go to the next leftest node
+    root = other.root;
+    leftmost = other.leftmost;
+    rightmost = other.rightmost;
+    pred = other.pred;
+    tree_size = other.tree_size;
+    other.root = other.leftmost = other.rightmost = nullptr;
+    other.tree_size = 0;
+    // heap nodes are shared by pointer, only the nodes inside the other object have to move, each to the same slot here
+    this->slab_copy_state(other);
+    for (size_t i = 0; i < this->slab_extent(); ++i)
     {
-        current_node = current_node->right;
-        // keep going to the farthest left of the right
-        while (current_node->left != nullptr) { current_node = current_node->left; }
-        return current_node;
+        if (!this->slab_used(i)) { continue; }
+        node* old_node = static_cast<node*>(other.slab_at(i));
+        node* moved = new (this->slab_at(i)) node(std::move(old_node->value), old_node->balance);
+        moved->left = old_node->left;
+        moved->right = old_node->right;
+        moved->parent = old_node->parent;
+        if (moved->left != nullptr) { moved->left->parent = moved; }
+        if (moved->right != nullptr) { moved->right->parent = moved; }
+        if (moved->parent == nullptr) { root = moved; }
+        else if (moved->parent->left == old_node) { moved->parent->left = moved; }
+        else { moved->parent->right = moved; }
+        if (leftmost == old_node) { leftmost = moved; }
+        if (rightmost == old_node) { rightmost = moved; }
+        old_node->~node();
     }
-    else // if nothing is on the right, then already at the largest value
+    other.slab_reset();
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::find_next_node() // find the node, whose value is the next larger one than the given node
+{
+    return this_node->successor();
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::find_next_node() // find the node, whose value is the next larger one than the given node
+{
+    return this_node->successor();
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::find_previous_node()
+{
+    return this_node->predecessor();
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::find_previous_node()
+{
+    return this_node->predecessor();
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::node() : left(nullptr), right(nullptr), parent(nullptr) { }
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::node(T val, unsigned char _balance) : value(std::move(val)), left(nullptr), right(nullptr), parent(nullptr), balance(_balance) { }
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node::insert_node(node* new_node, const compare_type& _pred, stats_handle_type stats, size_t depth)
+{
+    node* current = this;
+    node* candidate = nullptr; // the last node the new value did not go left of, the only one it can be equal to
+    node** slot = nullptr;
+    bool duplicate = false;
+    // walk down to the empty child the new node belongs in, with one comparison per level
+    while (true)
     {
-        std::string node_position = current_node->find_node_position();
-        // keep going to find whether this is coming from a left child
-        while (current_node->parent != nullptr)
+        stats.visit();
+        stats.compare();
+        ++depth;
+        bool to_left;
+        if (three_way::enabled)
         {
-            if (node_position == "left") { return current_node->parent; } // came from left the return parent
-            else // otherwise keep going
-            {
-                current_node = current_node->parent;
-                node_position = current_node->find_node_position();
-            }
+            const int order = three_way::compare(_pred, new_node->value, current->value);
+            if (order == 0) { duplicate = true; break; }
+            to_left = order < 0;
         }
-        return nullptr; //return null is it is the largest
+        else
+        {
+            to_left = _pred(new_node->value, current->value);
+            if (!to_left) { candidate = current; }
+        }
+        slot = to_left ? &current->left : &current->right;
+        if (*slot == nullptr) { break; }
+        current = *slot;
+    }
+    stats.lookup_done(depth);
+    // without a three-way comparator, one last comparison tells whether the new value equals the candidate
+    if (!three_way::enabled && candidate != nullptr)
+    {
+        stats.compare();
+        duplicate = !_pred(candidate->value, new_node->value);
     }
+    if (duplicate) { return false; } // the value inserted is repeated, so do nothing
+    *slot = new_node;
+    new_node->parent = current;
+    return true; // the tree rebalances once the node is linked in
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator++()
+{
+    // simply return the next node found by the helper function
+    this_node = find_next_node();
+    return *this;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator++()
+{
+    // simply return the next node found by the helper function
+    this_node = find_next_node();
+    return *this;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator++(int)
+{
+    // use the prefix to define postfix
+    iterator copy(*this);
+    ++(*this);
+    return copy;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator++(int)
+{
+    // use the prefix to define postfix
+    const_iterator copy(*this);
+    ++(*this);
+    return copy;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator--()
+{
+    // simply return the previous node found by the helper function, or the largest node when stepping back from end()
+    this_node = this_node != nullptr ? find_previous_node() : container->rightmost;
+    return *this;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator--()
+{
+    // simply return the previous node found by the helper function, or the largest node when stepping back from end()
+    this_node = this_node != nullptr ? find_previous_node() : container->rightmost;
+    return *this;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator--(int)
+{
+    // use the prefix to define postfix
+    iterator copy(*this);
+    --(*this);
+    return copy;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator--(int)
+{
+    // use the prefix to define postfix
+    const_iterator copy(*this);
+    --(*this);
+    return copy;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const T& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator*() const
+{
+    // return value if found, else return null
+    if (this_node != nullptr) { return this_node->value; }
+    else { throw; } // throw an error if iterator point to null node
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const T& rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator*() const
+{
+    // return value if found, else return null
+    if (this_node != nullptr) { return this_node->value; }
+    else { throw; } // throw an error if iterator point to null node
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const T* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator->() const { return & (this_node->value); }
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+const T* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator->() const { return & (this_node->value); }
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator==(iterator other) const
+{
+    // two iterators are equal when they point to the same node, two end iterators are both nullptr and so equal
+    return this_node == other.this_node;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator==(const_iterator other) const
+{
+    // two iterators are equal when they point to the same node, two end iterators are both nullptr and so equal
+    return this_node == other.this_node;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::operator!=(iterator other) const
+{
+    return this_node != other.this_node; // compares node identity, never the values
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::operator!=(const_iterator other) const
+{
+    return this_node != other.this_node; // compares node identity, never the values
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::begin()
+{
+    // the left most child is cached, nullptr when the tree is empty
+    return iterator(leftmost, this);
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::begin() const
+{
+    // the left most child is cached, nullptr when the tree is empty
+    return const_iterator(leftmost, this);
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::end()
+{
+    // always return the null iterator since it is the past-the-end position
+    return iterator(nullptr, this);
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::end() const
+{
+    // always return the null iterator since it is the past-the-end position
+    return const_iterator(nullptr, this);
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator::print_iter_node(const std::string& depth_padding)
+{
+    const std::string node_position = this_node->find_node_position();
+    if (node_position == "root") { std::cout << "\n" << depth_padding << "-" << this_node->get_node_val(); }
+    else if (node_position == "left") { std::cout << "\n" << depth_padding << "\\" << this_node->get_node_val(); }
+    else { std::cout << "\n" << depth_padding << "/" << this_node->get_node_val(); }
+    balance_policy::write_tag(std::cout, this_node->balance); // the colour for red-black, (r) or (b)
+    std::cout << "\n";
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::const_iterator::print_iter_node(const std::string& depth_padding) const
+{
+    const std::string node_position = this_node->find_node_position();
+    if (node_position == "root") { std::cout << "\n" << depth_padding << "-" << this_node->get_node_val(); } // what to print for root
+    else if (node_position == "left") { std::cout << "\n" << depth_padding << "\\" << this_node->get_node_val(); } // what to print for left childs
+    else { std::cout << "\n" << depth_padding << "/" << this_node->get_node_val(); } // what to print for right child
+    balance_policy::write_tag(std::cout, this_node->balance); // the colour for red-black, (r) or (b)
+    std::cout << "\n";
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::insert(const T& other)
+{
+    link(make_node(other, balance_policy::leaf()));
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::node* rbt<T, compare_type>::iterator::find_previous_node()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::insert(T&& other)
 {
-    node* current_node = this_node;
-    if (current_node->left != nullptr)// if something is on the left, go to the next rightest node
-    {
-        current_node = current_node->left;
-        // keep going to the fartherest right of its left
-        while (current_node->right != nullptr) { current_node = current_node->right; }
-        return current_node;
-    }
-    else // if nothing is on the right, then already at the largest value
+    link(make_node(std::move(other), balance_policy::leaf()));
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::print()
+{
+    // a reverse in-order walk that carries each node's depth, instead of finding it again from the root
+    const std::string padding_per_depth = "          ";
+    std::vector< std::pair<node*, size_t> > pending;
+    std::string padding;
+    node* curr = root;
+    size_t depth = 0;
+    while (curr != nullptr || !pending.empty())
     {
-        std::string node_position = current_node->find_node_position();
-        // keep going to find whether this is coming from a right child
-        while (current_node->parent != nullptr)
-        {
-            if (node_position == "right") { return current_node->parent; } // came from right the return parent
-            else // otherwise keep going
-            {
-                current_node = current_node->parent;
-                node_position = current_node->find_node_position();
-            }
-        }
-        return nullptr; //return null is it is the smallest
+        for (; curr != nullptr; curr = curr->right, ++depth) { pending.emplace_back(curr, depth); } // larger values are printed first
+        curr = pending.back().first;
+        depth = pending.back().second;
+        pending.pop_back();
+        padding.clear();
+        for (size_t i = 0; i < depth; ++i) { padding += padding_per_depth; }
+        iterator(curr, this).print_iter_node(padding);
+        curr = curr->left;
+        ++depth;
     }
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::node* rbt<T, compare_type>::const_iterator::find_previous_node()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_quoted(std::ostream& out, const T& value, std::ostringstream& scratch)
 {
-    const node* current_node = this_node;
-    if (current_node->left != nullptr)// if something is on the left, go to the next rightest node
+    if (std::is_arithmetic<T>::value && sizeof(T) > 1) { out << '"' << value << '"'; return; } // nothing to escape, a char could be a quote
+    scratch.str(std::string());
+    scratch << value;
+    const std::string text = scratch.str();
+    out << '"';
+    for (const char c : text)
     {
-        current_node = current_node->left;
-        // keep going to the fartherest right of its left
-        while (current_node->right != nullptr) { current_node = current_node->right; }
-        return current_node;
+        if (c == '"' || c == '\\') { out << '\\' << c; }
+        else if (c == '\n') { out << "\\n"; }
+        else if (static_cast<unsigned char>(c) < 0x20) { out << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xf] << "0123456789abcdef"[c & 0xf]; }
+        else { out << c; }
     }
-    else // if nothing is on the right, then already at the largest value
+    out << '"';
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_json_value(std::ostream& out, const T& value, std::ostringstream&, std::true_type)
+{
+    if (std::is_same<T, bool>::value) { out << (value ? "true" : "false"); }
+    else if (!std::is_floating_point<T>::value) { out << +value; } // + promotes char and signed char to int
+    else if (std::isfinite(value)) { out << value; }
+    else { out << "null"; }
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::dump_dot(std::ostream& out, size_t max_depth, size_t max_nodes) const
+{
+    rbt_stream_buffer buffer(out.rdbuf());
+    std::ostream stream(&buffer);
+    std::ostringstream scratch;
+    stream << "digraph rbt {\n  node [style=filled, fontcolor=white];\n";
+
+    // a pre-order walk, each entry is a node with its depth and the id it is drawn with
+    struct entry { const node* current; size_t depth; size_t id; };
+    std::vector<entry> pending;
+    size_t written = 0;
+    if (root != nullptr && max_depth != 0 && max_nodes != 0) { pending.push_back(entry{ root, 1, written++ }); }
+    else if (root != nullptr) { stream << "  cut [label=\"...\", shape=plaintext, style=\"\", fontcolor=black];\n"; }
+    while (!pending.empty())
     {
-        std::string node_position = current_node->find_node_position();
-        // keep going to find whether this is coming from a right child
-        while (current_node->parent != nullptr)
+        const entry e = pending.back();
+        pending.pop_back();
+        stream << "  n" << e.id << " [label=";
+        write_quoted(stream, e.current->value, scratch);
+        stream << ", fillcolor=" << (balance_policy::highlighted(e.current->balance) ? "red" : "black") << "];\n";
+        // edges are written left then right so Graphviz lays the children out in order,
+        // and the right child is pushed first so the left subtree is written first
+        const node* children[2] = { e.current->left, e.current->right };
+        size_t ids[2] = { 0, 0 };
+        for (int side = 0; side < 2; ++side)
         {
-            if (node_position == "right") { return current_node->parent; } // came from right the return parent
-            else // otherwise keep going
+            if (children[side] == nullptr) { continue; }
+            if (e.depth < max_depth && written < max_nodes)
+            {
+                ids[side] = written++;
+                stream << "  n" << e.id << " -> n" << ids[side] << ";\n";
+            }
+            else
             {
-                current_node = current_node->parent;
-                node_position = current_node->find_node_position();
+                const char* name = side == 0 ? "l" : "r";
+                stream << "  cut" << e.id << name << " [label=\"...\", shape=plaintext, style=\"\", fontcolor=black];\n";
+                stream << "  n" << e.id << " -> cut" << e.id << name << ";\n";
+                children[side] = nullptr;
             }
         }
-        return nullptr; //return null is it is the smallest
+        if (children[1] != nullptr) { pending.push_back(entry{ children[1], e.depth + 1, ids[1] }); }
+        if (children[0] != nullptr) { pending.push_back(entry{ children[0], e.depth + 1, ids[0] }); }
     }
+    stream << "}\n";
+    stream.flush();
+    if (!stream) { throw std::runtime_error("rbt: failed writing stream"); }
 }
 
-template< typename T, typename compare_type >
-rbt<T, compare_type>::node::node() : left(nullptr), right(nullptr), parent(nullptr) { }
-
-template< typename T, typename compare_type >
-rbt<T, compare_type>::node::node(T val, std::string col) : left(nullptr), right(nullptr), parent(nullptr), value(val), color(col) { }
-
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::node::insert_node(node* new_node, compare_type _pred)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::dump_json(std::ostream& out, size_t max_depth, size_t max_nodes) const
 {
-    // insert node to the farthest left if it is smaller, until it is reaching null (it is the smallest of all) or find its right position
-    if (_pred(new_node->value, value))
+    rbt_stream_buffer buffer(out.rdbuf());
+    std::ostream stream(&buffer);
+    std::ostringstream scratch;
+    stream << "{\"size\": " << tree_size << ", \"root\": ";
+
+    // a depth-first walk that visits each node three times: to open it and start its left child,
+    // to start its right child, and to close it
+    struct entry { const node* current; size_t depth; int stage; bool truncated; };
+    std::vector<entry> pending;
+    size_t written = 0;
+    if (root != nullptr && max_depth != 0 && max_nodes != 0) { pending.push_back(entry{ root, 1, 0, false }); ++written; }
+    else { stream << "null"; }
+    while (!pending.empty())
     {
-        // if nothing is on the left, go connect the node pointers, n is left
-        if (!left)
+        entry& e = pending.back();
+        if (e.stage == 0)
         {
-            left = new_node;
-            new_node->parent = this;
-            if (parent == nullptr) { return; } // if inserting at root
-            correct_color_insert("left");
+            stream << "{\"value\": ";
+            write_json_value(stream, e.current->value, scratch, std::is_arithmetic<T>());
+            stream << ", \"" << balance_policy::field() << "\": ";
+            balance_policy::write_json(stream, e.current->balance);
         }
-        // if something is on the left, go compare recurssively
-        else { left->insert_node(new_node, _pred); }
-    }
-    // insert node to the farthest right if it is smaller, until it is reaching null (it is the largest of all) or find its right position
-    else if (_pred(value, new_node->value))
-    {
-        // if nothing is on the right, go connect the node pointers, n is right
-        if (!right)
+        if (e.stage == 2)
+        {
+            if (e.truncated) { stream << ", \"truncated\": true"; }
+            stream << '}';
+            pending.pop_back();
+            continue;
+        }
+        const node* child = e.stage == 0 ? e.current->left : e.current->right;
+        stream << (e.stage == 0 ? ", \"left\": " : ", \"right\": ");
+        ++e.stage;
+        if (child != nullptr && e.depth < max_depth && written < max_nodes)
+        {
+            ++written;
+            const size_t depth = e.depth + 1;
+            pending.push_back(entry{ child, depth, 0, false }); // e is not used after this, the push may move it
+        }
+        else
         {
-            right = new_node;
-            new_node->parent = this;
-            if (parent == nullptr) { return; } // if inserting at root
-            correct_color_insert("right");
+            if (child != nullptr) { e.truncated = true; }
+            stream << "null";
         }
-        // if something is on the right, go compare recurssively
-        else { right->insert_node(new_node, _pred); }
     }
-    else // this means the value inserted is repeated, so do nothing
+    stream << "}\n";
+    stream.flush();
+    if (!stream) { throw std::runtime_error("rbt: failed writing stream"); }
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::validate(std::string& problem) const
+{
+    if (root == nullptr)
     {
-        delete new_node;
-        new_node = NULL;
+        if (tree_size != 0) { problem = "empty tree with size " + std::to_string(tree_size); return false; }
+        return true;
     }
+    auto in_order = [this](const node* a, const node* b) { return pred(a->value, b->value); };
+    return rbt_links::validate<balance_policy>(root, tree_size, in_order, problem);
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator& rbt<T, compare_type>::iterator::operator++()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::validate() const
 {
-    // simply return the next node found by the helper function
-    this_node = find_next_node();
-    return *this;
+    std::string problem;
+    return validate(problem);
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator& rbt<T, compare_type>::const_iterator::operator++()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+rbt_health rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::health() const
 {
-    // simply return the next node found by the helper function
-    this_node = find_next_node();
-    return *this;
+    rbt_health result;
+    for (const node* current = root; current != nullptr; current = current->left) { result.black_height += balance_policy::path_weight(current->balance); }
+    // a depth-first walk with an explicit stack of nodes and their depths
+    std::vector< std::pair<const node*, size_t> > pending;
+    if (root != nullptr) { pending.emplace_back(root, 1); }
+    size_t depth_sum = 0;
+    while (!pending.empty())
+    {
+        const node* current = pending.back().first;
+        const size_t depth = pending.back().second;
+        pending.pop_back();
+        ++result.nodes;
+        depth_sum += depth;
+        if (depth > result.height) { result.height = depth; }
+        if (current->right != nullptr) { pending.emplace_back(current->right, depth + 1); }
+        if (current->left != nullptr) { pending.emplace_back(current->left, depth + 1); }
+    }
+    if (result.nodes != 0) { result.average_depth = static_cast<double>(depth_sum) / result.nodes; }
+    return result;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator rbt<T, compare_type>::iterator::operator++(int)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::erase(iterator iter)
 {
-    // use the prefix to define postfix
-    iterator copy(*this);
-    ++(*this);
-    return copy;
+    // if iterator not belong to this tree or points to a null node, then do nothing
+    if (iter.container != this || iter.this_node == nullptr) { return end(); }
+    node* next = iter.this_node->successor(); // found before unlinking, the relinking never moves it
+    unlink(iter.this_node);
+    return iterator(next, this);
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator rbt<T, compare_type>::const_iterator::operator++(int)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+size_t rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::erase(const T& value)
 {
-    // use the prefix to define postfix
-    const_iterator copy(*this);
-    ++(*this);
-    return copy;
+    node* found = lower_bound_node(value);
+    if (found == nullptr || pred(value, found->value)) { return 0; } // the first value not smaller is larger, so value is absent
+    unlink(found);
+    return 1;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator& rbt<T, compare_type>::iterator::operator--()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< typename K, typename C, typename >
+size_t rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::erase(const K& key)
 {
-    // simply return the previous node found by the helper function
-    this_node = find_previous_node();
-    return *this;
+    node* found = find_key_node(key);
+    if (found == nullptr) { return 0; }
+    unlink(found);
+    return 1;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator& rbt<T, compare_type>::const_iterator::operator--()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::iterator rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::erase(iterator first, iterator last)
 {
-    // simply return the previous node found by the helper function
-    this_node = find_previous_node();
-    return *this;
+    if (first.container != this || first == last) { return last; }
+    if (first == begin() && last.this_node == nullptr) // everything goes, so nothing needs relinking or recolouring
+    {
+        traverse_delete(root);
+        return end();
+    }
+    while (first != last) { first = erase(first); }
+    return last;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator rbt<T, compare_type>::iterator::operator--(int)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::unlink(node* doomed)
 {
-    // use the prefix to define postfix
-    iterator copy(*this);
-    --(*this);
-    return copy;
+    rbt_links::unlink<balance_policy>(root, leftmost, rightmost, doomed, this->stats_handle());
+    free_node(doomed);
+    --tree_size;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator rbt<T, compare_type>::const_iterator::operator--(int)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+T rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::pop_min()
 {
-    // use the prefix to define postfix
-    const_iterator copy(*this);
-    --(*this);
-    return copy;
+    if (leftmost == nullptr) { throw std::out_of_range("rbt::pop_min: the tree is empty"); }
+    T value = std::move(leftmost->value); // the node is unlinked without looking at its value
+    unlink(leftmost);
+    return value;
 }
 
-template< typename T, typename compare_type >
-const T& rbt<T, compare_type>::iterator::operator*() const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+T rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::pop_max()
 {
-    // return value if found, else return null
-    if (this_node != nullptr) { return this_node->value; }
-    else { throw; } // throw an error if iterator point to null node
+    if (rightmost == nullptr) { throw std::out_of_range("rbt::pop_max: the tree is empty"); }
+    T value = std::move(rightmost->value);
+    unlink(rightmost);
+    return value;
 }
 
-template< typename T, typename compare_type >
-const T& rbt<T, compare_type>::const_iterator::operator*() const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::reset_extremes()
 {
-    // return value if found, else return null
-    if (this_node != nullptr) { return this_node->value; }
-    else { throw; } // throw an error if iterator point to null node
+    leftmost = rightmost = root;
+    if (root == nullptr) { return; }
+    while (leftmost->left != nullptr) { leftmost = leftmost->left; }
+    while (rightmost->right != nullptr) { rightmost = rightmost->right; }
 }
 
-template< typename T, typename compare_type >
-const T* rbt<T, compare_type>::iterator::operator->() const { return & (this_node->value); }
-
-template< typename T, typename compare_type >
-const T* rbt<T, compare_type>::const_iterator::operator->() const { return & (this_node->value); }
-
-template< typename T, typename compare_type >
-bool rbt< T, compare_type >::iterator::operator==(iterator other) const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::fix_root()
 {
-    // check if two iterators are equal, note if both being null is considered NOT equal (return false)
-    if (this_node && other.this_node) { return this_node->get_node_val() == other.this_node->get_node_val(); }
-    // both nullptr is assumed to be equal
-    else if (this_node == nullptr && other.this_node == nullptr) { return true; }
-    // otherwise return false
-    else { return false; }
+    if (root == nullptr) { return; }
+    while (root->parent != nullptr) { root = root->parent; } // rotations only ever move the root down by one parent link
 }
 
-template< typename T, typename compare_type >
-bool rbt< T, compare_type >::const_iterator::operator==(const_iterator other) const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+size_t rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::sorted_depth(size_t count)
 {
-    // check if two iterators are equal, note if both being null is considered NOT equal (return false)
-    if (this_node && other.this_node) { return this_node->get_node_val() == other.this_node->get_node_val(); }
-    // both nullptr is assumed to be equal
-    else if (this_node == nullptr && other.this_node == nullptr) { return true; }
-    // otherwise return false
-    else { return false; }
+    size_t depth = 0;
+    while (count > 1) { count >>= 1; ++depth; } // floor(log2(count))
+    return depth;
 }
 
-template< typename T, typename compare_type >
-bool rbt< T, compare_type >::iterator::operator!=(iterator other) const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< typename Source >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::build_sorted(Source& source, size_t count, node* parent, size_t depth, size_t red_depth)
 {
-    // check if two iterators are not equal, note if both being null is considered NOT equal (return true)
-    if (this_node && other.this_node) { return this_node->get_node_val() != other.this_node->get_node_val(); }
-    // both nullptr are false for "not equal"
-    else if (this_node == nullptr && other.this_node == nullptr) { return false; }
-    // other wise return true
-    else { return true; }
+    if (count == 0) { return nullptr; }
+    const size_t left_count = (count - 1) / 2; // the middle value becomes the subtree root, the right side gets the extra one
+    node* left = build_sorted(source, left_count, nullptr, depth + 1, red_depth);
+    node* middle = nullptr;
+    try
+    {
+        bool red = depth == red_depth && depth != 0;
+        T value = source(red); // the source may overwrite red, so read it before using it
+        middle = make_node(std::move(value), balance_policy::built(red, sorted_depth(count) + 1));
+        this->stats_handle().allocate();
+        ++tree_size;
+        middle->left = left;
+        if (left != nullptr) { left->parent = middle; }
+        middle->right = build_sorted(source, count - 1 - left_count, middle, depth + 1, red_depth);
+    }
+    catch (...)
+    {
+        // nothing built here hangs from the tree yet, so free it before passing the error on; a failed right subtree freed itself
+        traverse_delete(middle != nullptr ? middle : left);
+        throw;
+    }
+    middle->parent = parent;
+    return middle;
 }
 
-template< typename T, typename compare_type >
-bool rbt< T, compare_type >::const_iterator::operator!=(const_iterator other) const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+bool rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::strictly_increasing() const
 {
-    // check if two iterators are not equal, note if both being null is considered NOT equal (return true)
-    if (this_node && other.this_node) { return this_node->get_node_val() != other.this_node->get_node_val(); }
-    // both nullptr are false for "not equal"
-    else if (this_node == nullptr && other.this_node == nullptr) { return false; }
-    // other wise return true
-    else { return true; }
+    const_iterator previous = begin();
+    for (const_iterator iter = previous; iter.this_node != nullptr; previous = iter)
+    {
+        ++iter;
+        if (iter.this_node != nullptr && !pred(*previous, *iter)) { return false; }
+    }
+    return true;
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator rbt<T, compare_type>::begin()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::save(const std::string& path) const
 {
-    // always go the left most child and return its iterator
-    if (root == nullptr) { return iterator(nullptr, this); }
-    node *n = root;
-    while (n->left != nullptr) { n = n->left; }
-    return iterator(n, this);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) { throw std::runtime_error("rbt::save: cannot open " + path); }
+
+    rbt_image_header header{};
+    std::memcpy(header.magic, "rbtimage", sizeof(header.magic));
+    header.version = rbt_image_header::current_version;
+    header.raw = rbt_serializer<T>::is_raw ? 1 : 0;
+    header.value_size = rbt_serializer<T>::is_raw ? sizeof(T) : 0;
+    header.value_align = rbt_serializer<T>::is_raw ? alignof(T) : 0;
+    header.count = tree_size;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    // the image always loads into the same balanced shape, whose colours follow from the count, so only the values are stored
+    for (const_iterator iter = begin(); iter != end(); ++iter) { rbt_serializer<T>::write(out, *iter); }
+    if (!out) { throw std::runtime_error("rbt::save: failed writing " + path); }
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator rbt<T, compare_type>::begin() const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::load(const std::string& path)
 {
-    // always go the left most child and return its iterator
-    if (root == nullptr) { return const_iterator(nullptr, this); }
-    node *n = root;
-    while (n->left != nullptr) { n = n->left; }
-    return const_iterator(n, this);
+    std::ifstream values(path, std::ios::binary);
+    if (!values) { throw std::runtime_error("rbt::load: cannot open " + path); }
+    rbt_image_header header{};
+    values.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!values || std::memcmp(header.magic, "rbtimage", sizeof(header.magic)) != 0) { throw std::runtime_error("rbt::load: " + path + " is not an rbt image"); }
+    if (header.version != rbt_image_header::current_version) { throw std::runtime_error("rbt::load: unsupported image version in " + path); }
+    if (header.raw != (rbt_serializer<T>::is_raw ? 1u : 0u) || (header.raw && header.value_size != sizeof(T))) { throw std::runtime_error("rbt::load: " + path + " holds a different value type"); }
+
+    // the colours depend only on the count, so build_sorted works them out again
+    auto source = [&](bool&)
+    {
+        T value = rbt_serializer<T>::read(values);
+        if (!values) { throw std::runtime_error("rbt::load: " + path + " is truncated"); }
+        return value;
+    };
+
+    rbt loaded(pred);
+    loaded.root = loaded.build_sorted(source, static_cast<size_t>(header.count), nullptr, 0, sorted_depth(static_cast<size_t>(header.count)));
+    loaded.reset_extremes();
+    if (!loaded.strictly_increasing()) { throw std::runtime_error("rbt::load: the values in " + path + " are not strictly increasing"); }
+    swap(loaded);
 }
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::iterator rbt<T, compare_type>::end()
+#if RBT_POSIX
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::mapped
 {
-    // always return the null iterator since it is the past-the-end position
-    return iterator(nullptr, this);
+    friend rbt;
+    static_assert(rbt_serializer<T>::is_raw, "only images of trivially copyable values can be mapped");
+private:
+    void* base = nullptr; // start of the mapping
+    size_t length = 0; // length of the mapping in bytes
+    const T* values = nullptr; // the sorted values, right after the header
+    size_t count = 0;
+    compare_type pred;
+    mapped(const compare_type& _pred) : pred(_pred) { }
+public:
+    mapped(mapped&& other) noexcept : base(other.base), length(other.length), values(other.values), count(other.count), pred(other.pred) { other.base = nullptr; other.length = 0; }
+    mapped(const mapped&) = delete;
+    mapped& operator=(const mapped&) = delete;
+    ~mapped() { if (base != nullptr) { munmap(base, length); } }
+
+    /**
+     @return the number of values in the image
+     */
+    size_t size() const { return count; }
+
+    /**
+     @return a pointer to the smallest value
+     */
+    const T* begin() const { return values; }
+
+    /**
+     @return a pointer past the largest value
+     */
+    const T* end() const { return values + count; }
+
+    /**
+     binary search for a value in the mapped image
+     @param value is the value to look for
+     @return a pointer to the stored value, or end() if it is not there
+     */
+    const T* find(const T& value) const
+    {
+        const T* first = values;
+        size_t len = count;
+        while (len > 0) // lower bound
+        {
+            const size_t half = len / 2;
+            if (pred(first[half], value)) { first += half + 1; len -= half + 1; }
+            else { len = half; }
+        }
+        if (first != end() && !pred(value, *first)) { return first; }
+        return end();
+    }
+};
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::mapped rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::map(const std::string& path, const compare_type& _pred)
+{
+    mapped view(_pred);
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw std::runtime_error("rbt::map: cannot open " + path); }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(rbt_image_header))
+    {
+        ::close(fd);
+        throw std::runtime_error("rbt::map: " + path + " is not an rbt image");
+    }
+    view.length = static_cast<size_t>(info.st_size);
+    void* base = mmap(nullptr, view.length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (base == MAP_FAILED) { throw std::runtime_error("rbt::map: cannot map " + path); }
+    view.base = base;
+
+    const rbt_image_header* header = static_cast<const rbt_image_header*>(base);
+    if (std::memcmp(header->magic, "rbtimage", sizeof(header->magic)) != 0 || header->version != rbt_image_header::current_version) { throw std::runtime_error("rbt::map: " + path + " is not a supported rbt image"); }
+    if (header->raw != 1 || header->value_size != sizeof(T) || header->value_align != alignof(T)) { throw std::runtime_error("rbt::map: " + path + " holds a different value type"); }
+    if (header->count > (view.length - sizeof(rbt_image_header)) / sizeof(T)) { throw std::runtime_error("rbt::map: " + path + " is truncated"); }
+    view.count = static_cast<size_t>(header->count);
+    view.values = reinterpret_cast<const T*>(static_cast<const char*>(base) + sizeof(rbt_image_header));
+    return view;
 }
+#endif
 
-template< typename T, typename compare_type >
-typename rbt<T, compare_type>::const_iterator rbt<T, compare_type>::end() const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::frozen
 {
-    // always return the null iterator since it is the past-the-end position
-    return const_iterator(nullptr, this);
+    friend rbt;
+private:
+    std::vector<T> values; // values[1] is the root and values[2i], values[2i + 1] are the children of values[i]; values[0] is unused
+    size_t count = 0;
+    compare_type pred;
+    static constexpr size_t prefetch_stride = sizeof(T) < 64 ? 64 / sizeof(T) : 1; // slots per cache line, so 16 ints are 4 levels ahead
+
+    frozen(const compare_type& _pred, size_t n) : count(n), pred(_pred) { values.reserve(n + 1); }
+
+    void prefetch(size_t slot) const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        if (slot <= count) { __builtin_prefetch(values.data() + slot); }
+#endif
+    }
+
+    /**
+     the search makes a fixed number of steps, turning each comparison into the next index instead of a branch
+     @return the slot of the first value not smaller than value, 0 if every value is smaller
+     */
+    size_t lower_bound_slot(const T& value) const
+    {
+        size_t slot = 1;
+        while (slot <= count)
+        {
+            prefetch(slot * prefetch_stride); // the great-grandchildren share one cache line, fetch it while this level is compared
+            slot = 2 * slot + static_cast<size_t>(pred(values[slot], value)); // right when the value here is too small
+        }
+        // the path ended below the answer: every right step after the last left one passed a smaller value
+        return rbt_eytzinger::up_from_right(slot);
+    }
+
+public:
+    /**
+     the iterator of a frozen copy, in increasing order, each step is index arithmetic on the array
+     */
+    class const_iterator
+    {
+        friend frozen;
+    private:
+        const frozen* container = nullptr;
+        size_t slot = 0; // 0 is past the end
+        const_iterator(const frozen* _container, size_t _slot) : container(_container), slot(_slot) { }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+        const T& operator*() const { return container->values[slot]; }
+        const T* operator->() const { return &container->values[slot]; }
+        const_iterator& operator++() { slot = rbt_eytzinger::next(slot, container->count); return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const const_iterator& other) const { return slot == other.slot; }
+        bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+    };
+    using iterator = const_iterator;
+
+    /**
+     @return the number of values
+     */
+    size_t size() const { return count; }
+
+    /**
+     @return true if there are no values
+     */
+    bool empty() const { return count == 0; }
+
+    /**
+     @return an iterator to the smallest value
+     */
+    const_iterator begin() const { return const_iterator(this, rbt_eytzinger::first(count)); }
+
+    /**
+     @return the past-the-end iterator
+     */
+    const_iterator end() const { return const_iterator(this, 0); }
+
+    /**
+     find the first value not smaller than the given one
+     @param value is the value to look for
+     @return its iterator, or end() if every value is smaller
+     */
+    const_iterator lower_bound(const T& value) const { return const_iterator(this, lower_bound_slot(value)); }
+
+    /**
+     find a value, the lower bound search and one more comparison
+     @param value is the value to look for
+     @return its iterator, or end() if it is not there
+     */
+    const_iterator find(const T& value) const
+    {
+        const size_t slot = lower_bound_slot(value);
+        return const_iterator(this, slot != 0 && !pred(value, values[slot]) ? slot : 0);
+    }
+
+    /**
+     Build a mutable rbt with the same values, in linear time
+     @return the new tree
+     */
+    rbt thaw() const;
+};
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::frozen rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::freeze() const
+{
+    // one in-order walk finds the value of every slot, then the values are copied in slot order, so T needs no default constructor
+    frozen copy(pred, tree_size);
+    std::vector<const T*> by_slot(tree_size + 1, nullptr);
+    size_t slot = rbt_eytzinger::first(tree_size);
+    for (const T& value : *this)
+    {
+        by_slot[slot] = &value;
+        slot = rbt_eytzinger::next(slot, tree_size);
+    }
+    if (tree_size != 0) { copy.values.push_back(*by_slot[1]); } // slot 0 is never read, it only puts the root at index 1
+    for (size_t s = 1; s <= tree_size; ++s) { copy.values.push_back(*by_slot[s]); }
+    return copy;
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::iterator::print_iter_node(const std::string& depth_padding)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+rbt<T, compare_type, stats_policy, balance_policy, inline_nodes> rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::frozen::thaw() const
 {
-    const std::string node_position = this_node->find_node_position();
-    const std::string color_abrev = (this_node->color == "red") ? "(r)" : "(b)";
-    if (node_position == "root") { std::cout << "\n" << depth_padding << "-" << this_node->get_node_val() << color_abrev << "\n"; }
-    else if (node_position == "left") { std::cout << "\n" << depth_padding << "\\" << this_node->get_node_val() << color_abrev << "\n"; }
-    else { std::cout << "\n" << depth_padding << "/" << this_node->get_node_val() << color_abrev << "\n"; }
+    rbt built(pred);
+    size_t slot = rbt_eytzinger::first(count);
+    auto source = [&](bool&)
+    {
+        const size_t here = slot;
+        slot = rbt_eytzinger::next(slot, count);
+        return values[here];
+    };
+    built.root = built.build_sorted(source, count, nullptr, 0, sorted_depth(count));
+    built.reset_extremes();
+    return built;
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::const_iterator::print_iter_node(const std::string& depth_padding) const
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< typename K >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::lower_bound_node(const K& value) const
 {
-    const std::string node_position = this_node->find_node_position();
-    const std::string color_abrev = (this_node->color == "red") ? "(r)" : "(b)";
-    if (node_position == "root") { std::cout << "\n" << depth_padding << "-" << this_node->get_node_val() << color_abrev << "\n"; } // what to print for root
-    else if (node_position == "left") { std::cout << "\n" << depth_padding << "\\" << this_node->get_node_val() << color_abrev << "\n"; } // what to print for left childs
-    else { std::cout << "\n" << depth_padding << "/" << this_node->get_node_val() << color_abrev << "\n"; } // what to print for right child
+    const stats_handle_type stats = this->stats_handle();
+    node* current = root;
+    node* found = nullptr;
+    size_t depth = 0;
+    while (current != nullptr)
+    {
+        stats.visit();
+        stats.compare();
+        ++depth;
+        if (pred(current->value, value)) { current = current->right; } // everything here and to the left is too small
+        else { found = current; current = current->left; } // candidate, look for a smaller one
+    }
+    stats.lookup_done(depth);
+    return found;
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::insert(const T& other)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::find_node(const T& value) const
 {
-    // if not exist a root, get new root
-    if (root == NULL)
+    if (!three_way::enabled)
     {
-        root = new node(other, "black"); // root is always black
-        ++tree_size;
+        // the lower bound is the only node that can be equal, so equality costs one more comparison instead of one per level
+        node* found = lower_bound_node(value);
+        const stats_handle_type stats = this->stats_handle();
+        if (found != nullptr && (stats.compare(), pred(value, found->value))) { found = nullptr; }
+        return found;
     }
-    // otherwise, recursively insert from the root
-    else
+    const stats_handle_type stats = this->stats_handle();
+    node* current = root;
+    size_t depth = 0;
+    while (current != nullptr)
     {
-        node *new_node = new node(other, "red"); // if not root, always initialize to red
-        root->insert_node(new_node, pred);
-        ++tree_size;
+        stats.visit();
+        stats.compare();
+        ++depth;
+        const int order = three_way::compare(pred, value, current->value);
+        if (order == 0) { break; } // stop as soon as it is found
+        current = order < 0 ? current->left : current->right;
     }
-    root->color = "black";
+    stats.lookup_done(depth);
+    return current;
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::insert(T&& other)
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< typename K >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::find_key_node(const K& key) const
+{
+    node* found = lower_bound_node(key);
+    if (found != nullptr && (this->stats_handle().compare(), pred(key, found->value))) { found = nullptr; } // the first value not smaller is larger
+    return found;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::node* rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::largest_node() const
+{
+    node* current = root;
+    while (current != nullptr && current->right != nullptr) { current = current->right; }
+    return current;
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_run(std::streambuf* out, node* first, size_t count, rbt_format format, size_t chunk) const
 {
-    // if not exist a root, get new root
-    if (root == NULL)
+    rbt_stream_buffer buffer(out, chunk);
+    std::ostream stream(&buffer);
+    if (format == rbt_format::binary)
     {
-        root = new node(std::move(other), "black");
-        ++tree_size;
+        const std::uint64_t n = count;
+        stream.write("rbtstrm1", 8);
+        stream.write(reinterpret_cast<const char*>(&n), sizeof(n));
     }
-    //otherwise, recursively insert from the root
-    else
+    else { stream << count << '\n'; }
+
+    const_iterator iter(first, this);
+    for (size_t i = 0; i < count; ++i, ++iter)
     {
-        node *new_node = new node(std::move(other), "red");
-        root->insert_node(new_node, pred);
-        ++tree_size;
+        if (format == rbt_format::binary) { rbt_serializer<T>::write(stream, *iter); }
+        else { rbt_serializer<T>::write_text(stream, *iter); }
     }
-    root->color = "black";
+    stream.flush();
+    if (!stream) { throw std::runtime_error("rbt: failed writing stream"); }
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::print()
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_sorted(std::ostream& out, rbt_format format, size_t chunk) const
 {
-    iterator curr = largest();
-    while (curr.this_node != nullptr)
-    {
-        int curr_depth = node_depth(root, curr.this_node, 0);
-        const std::string padding_per_depth = "          ";
-        std::string curr_padding = "";
-        for (int i = 0; i < curr_depth; ++i) { curr_padding += padding_per_depth; }
-        curr.print_iter_node(curr_padding);
-        --curr;
-    }
+    write_run(out.rdbuf(), begin().this_node, tree_size, format, chunk);
 }
 
-template< typename T, typename compare_type >
-void rbt<T, compare_type>::erase(rbt<T, compare_type>::iterator iter)
+#if RBT_POSIX
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_sorted(int fd, rbt_format format, size_t chunk) const
 {
-    // if iterator not belong to this tree or points to a null node, then do nothing
-    if (iter.container != this || iter.this_node == nullptr) { return; }
-    
-    // now the iterator to delete must exist within the correct tree with a valid value, it cannot point to a calue doesn't exist in this tree
-    node *curr = iter.this_node;
-    std::string node_position = curr->find_node_position();
+    rbt_stream_buffer buffer(fd, chunk);
+    write_run(&buffer, begin().this_node, tree_size, format, chunk);
+    if (buffer.pubsync() != 0) { throw std::runtime_error("rbt: failed writing stream"); }
+}
+#endif
 
-    node* sibling = curr->find_node_sibling();
-    std::string sibling_color = "black";
-    if (sibling != nullptr && sibling->color == "red") { sibling_color = "red"; }
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_range(std::ostream& out, const T& lo, const T& hi, rbt_format format, size_t chunk) const
+{
+    // one seek, then count the run first so the stream can be prefixed with its length without buffering it
+    node* first = lower_bound_node(lo);
+    size_t count = 0;
+    for (const_iterator iter(first, this); iter.this_node != nullptr && pred(*iter, hi); ++iter) { ++count; }
+    write_run(out.rdbuf(), first, count, format, chunk);
+}
 
-    
-    //if trying to delete node with no left nor right child, simply points its parent's corresponding to nullptr
-    if (curr->left == nullptr && curr->right == nullptr)
+#if RBT_POSIX
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::write_range(int fd, const T& lo, const T& hi, rbt_format format, size_t chunk) const
+{
+    rbt_stream_buffer buffer(fd, chunk);
+    std::ostream out(&buffer);
+    write_range(out, lo, hi, format, chunk);
+    if (buffer.pubsync() != 0) { throw std::runtime_error("rbt: failed writing stream"); }
+}
+#endif
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::read_sorted(std::istream& in, rbt_format format)
+{
+    std::uint64_t count = 0;
+    if (format == rbt_format::binary)
     {
-        // color corrections
-        if (curr->color == "red") { } // if itself is red and has no children
-        if (curr->color == "black" && node_position != "root") // if itself is black and has no children and is not root
-        {
-            curr->color = "double-black"; // first set to double-black, to hint need to go up to fix depth
-            // has a red sibling and is left child of parent
-            if (sibling_color == "red" && node_position == "left") { curr->parent->left_rotate(); }
-            // has a red sibling and is right child of parent
-            else if (sibling_color == "red" && node_position == "right") { curr->parent->right_rotate(); }
-        }
-        --tree_size; // size corrections
-        
-        // connection corrections
-        if (node_position == "left") { curr->parent->left = nullptr; }
-        else if (node_position == "right") { curr->parent->right = nullptr; }
-        else { } // else, node_positon == 0, only has a root and deleting the root, nothing really to do
-        curr->parent = nullptr;
-        iter.container = nullptr;
-        delete curr;
-        root->color = "black";
-    } // end of both left and right are empty
-    
-    // if tring to delete node with right child only, connect its right child to it's parent's corresponding child. If deleting the root, make the right child the new root.
-    else if (curr->left == nullptr && curr->right != nullptr)
+        char magic[8];
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in || std::memcmp(magic, "rbtstrm1", sizeof(magic)) != 0) { throw std::runtime_error("rbt::read_sorted: not an rbt stream"); }
+    }
+    else
     {
-        curr->correct_color_erase(); // color correction
-        --tree_size; // size correction
-        // connection correstions
-        if (node_position == "root") // deleting root node
-        {
-            curr->right->parent = nullptr;
-            root = curr->right;
-        }
-        else if (node_position == "left") // deleting parent's left child
-        {
-            curr->parent->left = curr->right;
-            curr->right->parent = curr->parent;
-        }
-        else // deleting parent's right child
-        {
-            curr->parent->right = curr->right;
-            curr->right->parent = curr->parent;
-        }
-        curr->parent = nullptr;
-        curr->right = nullptr;
-        iter.container = nullptr;
-        delete curr;
-        root->color = "black";
-    } // end of left empty, right non-empty
-    
-    // if tring to delete node with left child only, connect its left child to it's parent's corresponding child. If deleting the root, make the left child the new root.
-    else if (curr->left != nullptr && curr->right == nullptr)
+        in >> count;
+        in.ignore(1); // the newline after the count
+        if (!in) { throw std::runtime_error("rbt::read_sorted: missing count"); }
+    }
+
+    rbt built(pred);
+    auto source = [&](bool&)
     {
-        curr->correct_color_erase(); // color correction
-        --tree_size; // size correction
-        if (node_position == "root") // deleting root node
-        {
-            curr->left->parent = nullptr;
-            root = curr->left;
-        }
-        else if (node_position == "left") // deleting parent's left child
-        {
-            curr->parent->left = curr->right;
-            curr->right->parent = curr->parent;
-        }
-        else // deleting parent's right child
-        {
-            curr->parent->right = curr->right;
-            curr->right->parent = curr->parent;
-        }
-        curr->parent = nullptr;
-        curr->left = nullptr;
-        iter.container = nullptr;
-        delete curr;
-        root->color = "black";
-    } // end of left non-empty, right is empty
-    
-    // get both left and right child, find the next larger node, put its value to this node, and call erase recurssively on the next larger node
-    else
+        T value = format == rbt_format::binary ? rbt_serializer<T>::read(in) : rbt_serializer<T>::read_text(in);
+        if (!in) { throw std::runtime_error("rbt::read_sorted: stream ended early"); }
+        return value;
+    };
+    built.root = built.build_sorted(source, static_cast<size_t>(count), nullptr, 0, sorted_depth(static_cast<size_t>(count)));
+    built.reset_extremes();
+
+    if (!built.strictly_increasing()) { throw std::runtime_error("rbt::read_sorted: values are not strictly increasing"); }
+    swap(built);
+}
+
+#if RBT_POSIX
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+void rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::read_sorted(int fd, rbt_format format, size_t chunk)
+{
+    rbt_stream_buffer buffer(fd, chunk);
+    std::istream in(&buffer);
+    read_sorted(in, format);
+}
+#endif
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+template< bool reversed >
+class rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::basic_range
+#if __cplusplus >= 202002L
+    : public std::ranges::view_base
+#endif
+{
+    friend rbt;
+private:
+    node* first = nullptr; // first node visited
+    node* stop = nullptr; // node the walk stops at, never visited
+    basic_range(node* _first, node* _stop) : first(_first), stop(_stop) { }
+public:
+    /**
+     the iterator of a range view, each step is one pointer-only successor or predecessor step
+     */
+    class iterator
     {
-        node* smallest_next_node = iter.find_next_node();
-        iterator smallest_next_iter = iterator(smallest_next_node, this);
-        iter.this_node->value = smallest_next_node->value;
-        erase(smallest_next_iter);
-    } // end of having both left and right child
+        friend basic_range;
+    private:
+        node* this_node = nullptr;
+        explicit iterator(node* _node) : this_node(_node) { }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator() = default;
+        const T& operator*() const { return this_node->value; }
+        const T* operator->() const { return &this_node->value; }
+        iterator& operator++() { this_node = reversed ? this_node->predecessor() : this_node->successor(); return *this; }
+        iterator operator++(int) { iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const iterator& other) const { return this_node == other.this_node; }
+        bool operator!=(const iterator& other) const { return this_node != other.this_node; }
+    };
+
+    basic_range() = default;
+
+    /**
+     @return an iterator to the first value of the view
+     */
+    iterator begin() const { return iterator(first); }
+
+    /**
+     @return the past-the-end iterator of the view
+     */
+    iterator end() const { return iterator(stop); }
+
+    /**
+     @return true if the view has no values
+     */
+    bool empty() const { return first == stop; }
+};
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::range_view rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::range(const T& lo, const T& hi) const
+{
+    if (!pred(lo, hi)) { return range_view(); }
+    // the stop node is found by the same kind of walk, so each step after the seek is a pointer compare, not a value compare
+    return range_view(lower_bound_node(lo), lower_bound_node(hi));
+}
+
+template< typename T, typename compare_type, typename stats_policy, typename balance_policy, size_t inline_nodes >
+typename rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::reverse_range_view rbt<T, compare_type, stats_policy, balance_policy, inline_nodes>::reverse_range(const T& lo, const T& hi) const
+{
+    if (!pred(lo, hi)) { return reverse_range_view(); }
+    node* low = lower_bound_node(lo);
+    node* high = lower_bound_node(hi);
+    if (low == high) { return reverse_range_view(); }
+    // walk down from the value before hi to the one before lo
+    node* first = high != nullptr ? high->predecessor() : largest_node();
+    return reverse_range_view(first, low->predecessor());
 }
 
 #endif /* rbt_h */
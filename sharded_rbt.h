@@ -0,0 +1,454 @@
+#ifndef sharded_rbt_h
+#define sharded_rbt_h
+#include "rbt.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ an ordered set split by value range into shards, each an independent rbt behind its own mutex, so threads that touch
+ different ranges never wait for each other
+ shard k holds the values from the (k-1)th bound up to the kth; a set starts with every value in shard 0 and the bounds
+ move on their own: every check_interval changes a shard compares its size with its neighbours', and when one is more than
+ twice the other, half the difference moves across and the bound between them follows; a shard over half as large again as
+ the average passes its excess along toward the emptier end
+ threads find their shard through the bounds under one of route_slots route locks, picked per thread, so finding a shard
+ does not contend either; moving a bound takes every route lock, then the two shard locks, always in that order
+ insert, erase and contains are safe from any thread; for_each visits the shards in order and is safe alongside them,
+ begin() and end() walk the shards in order too but only while no thread is changing the set
+ @tparam T is the value type
+ @tparam compare_type is the comparator, std::less<T> by default
+ @tparam balance_policy is rbt_red_black (the default), rbt_avl or rbt_wavl, for every shard
+*/
+template< typename T, typename compare_type = std::less<T>, typename balance_policy = rbt_red_black >
+class sharded_rbt
+{
+private:
+    using tree_type = rbt<T, compare_type, rbt_no_stats, balance_policy>;
+
+    static constexpr size_t route_slots = 32;
+    static constexpr size_t check_interval = 256;
+    static constexpr size_t rebalance_slack = 1024;
+    static constexpr size_t cache_line = 64;
+
+    struct shard
+    {
+        std::mutex lock;
+        tree_type tree;
+        std::atomic<size_t> count; // tree.size(), readable without the lock
+        size_t changes = 0; // inserts and erases since the shard was made, under the lock
+        char padding[cache_line]; // keeps the locks of neighbouring shards off one cache line
+
+        shard() : count(0) { }
+    };
+
+    struct route_lock
+    {
+        std::mutex lock;
+        char padding[cache_line];
+    };
+
+    size_t shard_count;
+    std::unique_ptr<shard[]> shards;
+    std::unique_ptr<route_lock[]> routes;
+    std::vector<T> bounds; // bounds[k] is the smallest value shard k + 1 may hold, only the first bounds.size() + 1 shards are in use
+    compare_type pred;
+
+    /**
+     @return the tree of a shard, read only, for walking it with const iterators
+     */
+    const tree_type& tree_of(size_t k) const { return shards[k].tree; }
+
+    /**
+     @return the route lock of the calling thread
+     */
+    std::mutex& route() const;
+
+    /**
+     @return the shard whose range holds a value, under the bounds as they are now
+     */
+    size_t shard_of(const T& value) const { return std::upper_bound(bounds.begin(), bounds.end(), value, pred) - bounds.begin(); }
+
+    /**
+     find the shard whose range holds a value and lock it; the bounds cannot move while the route lock is held, and once the
+     shard is locked they cannot move past the values in it, so the route lock is let go
+     @param value is the value to route
+     @param k is set to the index of the shard
+     @return the lock of the shard, held
+     */
+    std::unique_lock<std::mutex> lock_shard(const T& value, size_t& k) const;
+
+    /**
+     count a change to a locked shard, and unlock it
+     @param k is the shard
+     @param locked is its lock
+     @return true if it is time to compare the shard with its neighbours
+     */
+    bool changed(size_t k, std::unique_lock<std::mutex>& locked);
+
+    /**
+     even out a shard with the neighbour it is most skewed against, or if it is not skewed but holds more than half as much
+     again as the average shard, push what it holds above the average to the neighbour on the side with fewer values per shard;
+     then do the same from the shard that took the values, so an excess travels along the shards until it reaches ones with room
+     @param k is the shard
+     */
+    void rebalance(size_t k);
+
+    /**
+     @return the size above which a shard holds too much, half as much again as the average plus rebalance_slack
+     */
+    static size_t heavy_size(size_t average) { return average + average / 2 + rebalance_slack; }
+
+    /**
+     tell from the shard counts alone, without any lock, whether rebalance would move anything from a shard
+     @param k is the shard
+     @return true if it is skewed against a neighbour or heavy
+     */
+    bool out_of_balance(size_t k) const;
+
+    /**
+     @return true if two shard sizes are far enough apart to even them out, one more than twice the other plus rebalance_slack
+     */
+    static bool skewed(size_t a, size_t b) { return std::max(a, b) > 2 * std::min(a, b) + rebalance_slack; }
+
+public:
+    /**
+     the iterator of a sharded_rbt, every value of shard 0, then of shard 1 and so on, which is increasing order
+     */
+    class const_iterator
+    {
+        friend sharded_rbt;
+    private:
+        const sharded_rbt* set;
+        size_t k;
+        typename tree_type::const_iterator at;
+
+        const_iterator(const sharded_rbt* _set, size_t _k, typename tree_type::const_iterator _at) : set(_set), k(_k), at(_at) { skip(); }
+
+        void skip() // past the end of a shard, on to the first value of the next one that has any
+        {
+            while (k + 1 < set->shard_count && at == set->tree_of(k).end()) { at = set->tree_of(++k).begin(); }
+        }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const T& operator*() const { return *at; }
+        const T* operator->() const { return &*at; }
+        const_iterator& operator++() { ++at; skip(); return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const const_iterator& other) const { return k == other.k && at == other.at; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+    using iterator = const_iterator;
+
+    /**
+     constructor for sharded_rbt
+     @param _shard_count is the number of shards, at least 1; a few times the number of writing threads spreads them well
+     @param _pred is the comparator
+     */
+    explicit sharded_rbt(size_t _shard_count = 16, const compare_type& _pred = compare_type());
+    sharded_rbt(const sharded_rbt&) = delete;
+    sharded_rbt& operator=(const sharded_rbt&) = delete;
+
+    /**
+     insert a value
+     @param value is the value to insert
+     @return true if it was inserted, false if an equal value was already there
+     */
+    bool insert(const T& value);
+    bool insert(T&& value);
+
+    /**
+     erase the value equal to the given one, if there is one
+     @param value is the value to remove
+     @return the number of values removed, 0 or 1
+     */
+    size_t erase(const T& value);
+
+    /**
+     @param value is the value to look for
+     @return true if an equal value is in the set
+     */
+    bool contains(const T& value) const;
+
+    /**
+     call a function on every value in increasing order; each shard is locked while it is visited and the bounds cannot move
+     until the walk is done, so every value that stays in the set throughout is visited exactly once
+     @param visit is called with each value while this thread holds its route lock and a shard lock, so it must not call
+     into the set at all, not even contains(), which would lock the route lock again and deadlock
+     */
+    template< typename Visit >
+    void for_each(Visit visit) const;
+
+    const_iterator begin() const { return const_iterator(this, 0, tree_of(0).begin()); }
+    const_iterator end() const { return const_iterator(this, shard_count - 1, tree_of(shard_count - 1).end()); }
+
+    /**
+     @return the number of values, exact when no thread is changing the set
+     */
+    size_t size() const;
+
+    /**
+     @return true if there are no values
+     */
+    bool empty() const { return size() == 0; }
+
+    /**
+     @return the number of shards
+     */
+    size_t shards_count() const { return shard_count; }
+
+    /**
+     @return the number of values in each shard, in order
+     */
+    std::vector<size_t> shard_sizes() const;
+
+    /**
+     Check every invariant with the whole set locked: each shard's tree, bounds in increasing order, every value inside its
+     shard's range and unused shards empty
+     @param problem is set to a description of the first broken invariant
+     @return true if the set is valid
+     */
+    bool validate(std::string& problem) const;
+
+    /**
+     Check every invariant
+     @return true if the set is valid
+     */
+    bool validate() const;
+};
+
+template< typename T, typename compare_type, typename balance_policy >
+sharded_rbt<T, compare_type, balance_policy>::sharded_rbt(size_t _shard_count, const compare_type& _pred) :
+    shard_count(_shard_count != 0 ? _shard_count : 1), shards(new shard[shard_count]), routes(new route_lock[route_slots]), pred(_pred)
+{
+    bounds.reserve(shard_count - 1);
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+std::mutex& sharded_rbt<T, compare_type, balance_policy>::route() const
+{
+    static thread_local const size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % route_slots;
+    return routes[slot].lock;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+std::unique_lock<std::mutex> sharded_rbt<T, compare_type, balance_policy>::lock_shard(const T& value, size_t& k) const
+{
+    std::lock_guard<std::mutex> routing(route());
+    k = shard_of(value);
+    return std::unique_lock<std::mutex>(shards[k].lock);
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::changed(size_t k, std::unique_lock<std::mutex>& locked)
+{
+    shard& s = shards[k];
+    s.count.store(s.tree.size(), std::memory_order_relaxed);
+    const bool check = ++s.changes % check_interval == 0;
+    locked.unlock();
+    return check;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::insert(const T& value)
+{
+    size_t k;
+    std::unique_lock<std::mutex> locked = lock_shard(value, k);
+    const size_t before = shards[k].tree.size();
+    shards[k].tree.insert(value);
+    if (shards[k].tree.size() == before) { return false; } // an equal value was there
+    if (changed(k, locked)) { rebalance(k); }
+    return true;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::insert(T&& value)
+{
+    size_t k;
+    std::unique_lock<std::mutex> locked = lock_shard(value, k);
+    const size_t before = shards[k].tree.size();
+    shards[k].tree.insert(std::move(value));
+    if (shards[k].tree.size() == before) { return false; } // an equal value was there
+    if (changed(k, locked)) { rebalance(k); }
+    return true;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+size_t sharded_rbt<T, compare_type, balance_policy>::erase(const T& value)
+{
+    size_t k;
+    std::unique_lock<std::mutex> locked = lock_shard(value, k);
+    const size_t erased = shards[k].tree.erase(value);
+    if (erased == 0) { return 0; }
+    if (changed(k, locked)) { rebalance(k); }
+    return erased;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::contains(const T& value) const
+{
+    size_t k;
+    std::unique_lock<std::mutex> locked = lock_shard(value, k);
+    return tree_of(k).find(value) != tree_of(k).end();
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::out_of_balance(size_t k) const
+{
+    if (shard_count == 1) { return false; }
+    const size_t own = shards[k].count.load(std::memory_order_relaxed);
+    if (own > heavy_size(size() / shard_count)) { return true; }
+    // k is a shard in use, so k + 1 is at most the first unused one and always a neighbour rebalance may move values to
+    if (k > 0 && skewed(own, shards[k - 1].count.load(std::memory_order_relaxed))) { return true; }
+    return k + 1 < shard_count && skewed(own, shards[k + 1].count.load(std::memory_order_relaxed));
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+void sharded_rbt<T, compare_type, balance_policy>::rebalance(size_t k)
+{
+    if (!out_of_balance(k)) { return; } // most checks find nothing to move, and must not stop every thread's routing to learn it
+    std::vector<std::unique_lock<std::mutex>> routing;
+    routing.reserve(route_slots);
+    for (size_t r = 0; r < route_slots; ++r) { routing.emplace_back(routes[r].lock); } // no thread is routing past here
+    const size_t average = size() / shard_count;
+    const size_t heavy = heavy_size(average);
+    bool pushing = false; // a heavy shard's excess is travelling, up or down, the way the first push chose
+    bool up = false;
+    size_t came_from = shard_count; // the shard the values just came from, which is not skewed against this one any more
+    for (size_t step = 0; step < 2 * shard_count; ++step) // values that move into a shard may leave it out of balance in turn
+    {
+        const size_t own = shards[k].count.load(std::memory_order_relaxed);
+        size_t other = k;
+        size_t widest = 0;
+        for (size_t j : { k - 1, k + 1 }) // the neighbour it is most skewed against, the next shard may be the first unused one
+        {
+            if (j >= shard_count || j > bounds.size() + 1 || j == came_from) { continue; } // k - 1 wraps around when k is 0
+            const size_t theirs = shards[j].count.load(std::memory_order_relaxed);
+            const size_t gap = own > theirs ? own - theirs : theirs - own;
+            if (skewed(own, theirs) && gap > widest) { other = j; widest = gap; }
+        }
+        if (other == k && own > heavy) // not skewed against either neighbour, but too large: push the excess toward the lighter side
+        {
+            if (!pushing)
+            {
+                size_t below = 0;
+                size_t above = 0;
+                for (size_t j = 0; j < shard_count; ++j) { (j < k ? below : above) += shards[j].count.load(std::memory_order_relaxed); }
+                above -= own;
+                up = k + 1 < shard_count && (k == 0 || above * k < below * (shard_count - 1 - k)); // fewer values per shard
+                pushing = true;
+            }
+            other = up ? k + 1 : k - 1;
+            if (other >= shard_count) { return; } // k - 1 wraps around when k is 0
+        }
+        if (other == k) { return; }
+        shard& low = shards[std::min(k, other)];
+        shard& high = shards[std::max(k, other)];
+        const size_t bound = std::min(k, other);
+        std::lock_guard<std::mutex> low_lock(low.lock);
+        std::lock_guard<std::mutex> high_lock(high.lock);
+        shard& from = k == bound ? low : high;
+        shard& to = k == bound ? high : low;
+        size_t moving = 0; // the sizes are exact now, a thread may have changed them since they were read
+        if (skewed(from.tree.size(), to.tree.size())) { moving = from.tree.size() > to.tree.size() ? (from.tree.size() - to.tree.size()) / 2 : 0; }
+        else if (from.tree.size() > heavy) { moving = from.tree.size() - average; }
+        if (moving == 0)
+        {
+            if (!skewed(from.tree.size(), to.tree.size())) { return; }
+            came_from = shard_count;
+            std::swap(k, other); // the neighbour is the larger one, even the pair out from its side
+            continue;
+        }
+        if (&from == &low) // the largest values of the lower shard move up, the bound comes down to the smallest of them
+        {
+            for (; moving > 0; --moving) { high.tree.insert(low.tree.pop_max()); }
+            if (bound == bounds.size()) { bounds.push_back(*high.tree.begin()); } // a shard comes into use
+            else { bounds[bound] = *high.tree.begin(); }
+        }
+        else // the smallest values of the upper shard move down, the bound goes up to the smallest that stays
+        {
+            for (; moving > 0; --moving) { low.tree.insert(high.tree.pop_min()); }
+            bounds[bound] = *high.tree.begin();
+        }
+        low.count.store(low.tree.size(), std::memory_order_relaxed);
+        high.count.store(high.tree.size(), std::memory_order_relaxed);
+        came_from = k;
+        k = other; // on to the shard that took the values
+    }
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+template< typename Visit >
+void sharded_rbt<T, compare_type, balance_policy>::for_each(Visit visit) const
+{
+    std::lock_guard<std::mutex> routing(route()); // holds the bounds still, so no value moves between shards behind the walk
+    for (size_t k = 0; k < shard_count; ++k)
+    {
+        std::lock_guard<std::mutex> locked(shards[k].lock);
+        for (const T& value : tree_of(k)) { visit(value); }
+    }
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+size_t sharded_rbt<T, compare_type, balance_policy>::size() const
+{
+    size_t total = 0;
+    for (size_t k = 0; k < shard_count; ++k) { total += shards[k].count.load(std::memory_order_relaxed); }
+    return total;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+std::vector<size_t> sharded_rbt<T, compare_type, balance_policy>::shard_sizes() const
+{
+    std::vector<size_t> sizes(shard_count);
+    for (size_t k = 0; k < shard_count; ++k) { sizes[k] = shards[k].count.load(std::memory_order_relaxed); }
+    return sizes;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::validate(std::string& problem) const
+{
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (size_t r = 0; r < route_slots; ++r) { locks.emplace_back(routes[r].lock); }
+    for (size_t k = 0; k < shard_count; ++k) { locks.emplace_back(shards[k].lock); }
+    for (size_t b = 1; b < bounds.size(); ++b)
+    {
+        if (!pred(bounds[b - 1], bounds[b])) { problem = "bound " + std::to_string(b) + " is not above the one before"; return false; }
+    }
+    for (size_t k = 0; k < shard_count; ++k)
+    {
+        const tree_type& tree = tree_of(k);
+        if (!tree.validate(problem)) { problem = "shard " + std::to_string(k) + ": " + problem; return false; }
+        if (tree.size() != shards[k].count.load()) { problem = "shard " + std::to_string(k) + " count differs from its size"; return false; }
+        if (tree.size() == 0) { continue; }
+        if (k > bounds.size()) { problem = "unused shard " + std::to_string(k) + " has values"; return false; }
+        if (k > 0 && pred(*tree.begin(), bounds[k - 1])) { problem = "shard " + std::to_string(k) + " holds a value below its range"; return false; }
+        auto last = tree.end();
+        --last;
+        if (k < bounds.size() && !pred(*last, bounds[k])) { problem = "shard " + std::to_string(k) + " holds a value above its range"; return false; }
+    }
+    return true;
+}
+
+template< typename T, typename compare_type, typename balance_policy >
+bool sharded_rbt<T, compare_type, balance_policy>::validate() const
+{
+    std::string problem;
+    return validate(problem);
+}
+
+#endif /* sharded_rbt_h */
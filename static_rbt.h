@@ -0,0 +1,222 @@
+#ifndef static_rbt_h
+#define static_rbt_h
+#include "rbt.h"
+#include <cstddef>
+#include <utility>
+
+/**
+ an rbt with room for exactly N values inside the object, for code that must not allocate after startup
+ every node lives in the tree's inline slots (see rbt_node_slab), taken from and given back to an index-linked free list in O(1);
+ once the tree is full, insert and emplace return false instead of allocating
+ insert and erase cost one walk down a tree of at most N values, a bounded number of rotations and one free list step,
+ so their worst case is fixed by N and does not depend on the state of an allocator
+ nodes are linked by pointers into the object itself, so moving or swapping the tree moves every node, which is O(N)
+ @tparam T is the data stored in the tree
+ @tparam compare_type is the rule to compare node values (of type T)
+ @tparam N is the capacity
+ @tparam balance_policy is rbt_red_black (the default), rbt_avl or rbt_wavl
+*/
+template< typename T, typename compare_type, size_t N, typename balance_policy = rbt_red_black >
+class static_rbt
+{
+    static_assert(N > 0, "a static_rbt needs room for at least one value");
+public:
+    using tree_type = rbt<T, compare_type, rbt_no_stats, balance_policy, N>;
+    using iterator = typename tree_type::iterator;
+    using const_iterator = typename tree_type::const_iterator;
+    using range_view = typename tree_type::range_view;
+    using reverse_range_view = typename tree_type::reverse_range_view;
+
+private:
+    tree_type tree;
+
+public:
+    /**
+     constructor, the storage for all N values is part of the object
+     @param _pred is the given compare type
+     */
+    explicit static_rbt(const compare_type& _pred = compare_type()) : tree(_pred) { }
+
+    /**
+     insert a copy of a value
+     @param value is the value to insert
+     @return true if it was inserted, false if it was already there or the tree is full
+     */
+    bool insert(const T& value);
+
+    /**
+     insert a value by moving it
+     @param value is the value to insert
+     @return true if it was inserted, false if it was already there or the tree is full
+     */
+    bool insert(T&& value);
+
+    /**
+     construct a value and insert it; nothing is constructed when the tree is full
+     @tparam Args are the arguments passed in to emplace together
+     @return true if it was inserted, false if it was already there or the tree is full
+     */
+    template< typename... Args >
+    bool emplace(Args&&... values);
+
+    /**
+     erase the value an iterator points to, its slot goes back on the free list
+     @param iter is an iterator to identify in the tree
+     @return an iterator to the value after the erased one, or end()
+     */
+    iterator erase(iterator iter) { return tree.erase(iter); }
+
+    /**
+     erase the value equal to the given one, or to a key when the comparator is transparent, if there is one
+     @param value is the value or key to remove
+     @return the number of values removed, 0 or 1
+     */
+    size_t erase(const T& value) { return tree.erase(value); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    size_t erase(const K& key) { return tree.erase(key); }
+
+    /**
+     erase every value in [first, last)
+     @param first is the first value to remove
+     @param last is the first value to keep
+     @return last
+     */
+    iterator erase(iterator first, iterator last) { return tree.erase(first, last); }
+
+    /**
+     remove the smallest value and return it
+     @return the value
+     @throws std::out_of_range if the tree is empty
+     */
+    T pop_min() { return tree.pop_min(); }
+
+    /**
+     remove the largest value and return it
+     @return the value
+     @throws std::out_of_range if the tree is empty
+     */
+    T pop_max() { return tree.pop_max(); }
+
+    /**
+     locate a value, or a key when the comparator is transparent
+     @param value is the value or key to look for
+     @return its iterator, or end() if not found
+     */
+    iterator find(const T& value) { return tree.find(value); }
+    const_iterator find(const T& value) const { return tree.find(value); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    iterator find(const K& key) { return tree.find(key); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    const_iterator find(const K& key) const { return tree.find(key); }
+
+    /**
+     find the first value not smaller than the given one, or than a key when the comparator is transparent
+     @param value is the value or key to look for
+     @return its iterator, or end() if every value is smaller
+     */
+    iterator lower_bound(const T& value) { return tree.lower_bound(value); }
+    const_iterator lower_bound(const T& value) const { return tree.lower_bound(value); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    iterator lower_bound(const K& key) { return tree.lower_bound(key); }
+    template< typename K, typename C = compare_type, typename = typename C::is_transparent >
+    const_iterator lower_bound(const K& key) const { return tree.lower_bound(key); }
+
+    iterator begin() { return tree.begin(); }
+    iterator end() { return tree.end(); }
+    const_iterator begin() const { return tree.begin(); }
+    const_iterator end() const { return tree.end(); }
+    iterator largest() { return tree.largest(); }
+    const_iterator largest() const { return tree.largest(); }
+
+    /**
+     View the values in [lo, hi) in increasing order
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @return the view, empty if hi is not larger than lo
+     */
+    range_view range(const T& lo, const T& hi) const { return tree.range(lo, hi); }
+
+    /**
+     View the values in [lo, hi) in decreasing order
+     @param lo is the smallest value to include
+     @param hi is the first value past the range
+     @return the view, empty if hi is not larger than lo
+     */
+    reverse_range_view reverse_range(const T& lo, const T& hi) const { return tree.reverse_range(lo, hi); }
+
+    /**
+     @return the number of values in the tree
+     */
+    size_t size() const { return tree.size(); }
+
+    /**
+     @return N, the most values the tree can hold
+     */
+    static constexpr size_t capacity() { return N; }
+
+    /**
+     @return true if no more values fit
+     */
+    bool full() const { return tree.size() == N; }
+
+    /**
+     Check every invariant of the tree
+     @return true if the tree is valid
+     */
+    bool validate() const { return tree.validate(); }
+
+    /**
+     Measure the shape of the tree in one O(n) pass
+     @return the node count, height, black-height and average depth
+     */
+    rbt_health health() const { return tree.health(); }
+
+    /**
+     swap the values of two trees, moving every node, O(N)
+     @param other is the tree to swap with
+     */
+    void swap(static_rbt& other) { tree.swap(other.tree); }
+
+    /**
+     The function used to print the structure of the tree, sideways with the largest value on top
+     */
+    void print() { tree.print(); }
+};
+
+/**
+ non-member swap function for static_rbt
+ @param tree1 is the "left hand side" static_rbt
+ @param tree2 is the "right hand side" static_rbt
+*/
+template< typename T, typename compare_type, size_t N, typename balance_policy >
+void swap(static_rbt<T, compare_type, N, balance_policy>& tree1, static_rbt<T, compare_type, N, balance_policy>& tree2) { tree1.swap(tree2); }
+
+template< typename T, typename compare_type, size_t N, typename balance_policy >
+bool static_rbt<T, compare_type, N, balance_policy>::insert(const T& value)
+{
+    if (full()) { return false; } // there is no free slot, and the heap is not an option
+    const size_t before = tree.size();
+    tree.insert(value);
+    return tree.size() != before; // a duplicate takes a slot for a moment and gives it straight back
+}
+
+template< typename T, typename compare_type, size_t N, typename balance_policy >
+bool static_rbt<T, compare_type, N, balance_policy>::insert(T&& value)
+{
+    if (full()) { return false; }
+    const size_t before = tree.size();
+    tree.insert(std::move(value));
+    return tree.size() != before;
+}
+
+template< typename T, typename compare_type, size_t N, typename balance_policy >
+template< typename... Args >
+bool static_rbt<T, compare_type, N, balance_policy>::emplace(Args&&... values)
+{
+    if (full()) { return false; }
+    const size_t before = tree.size();
+    tree.emplace(std::forward< Args >(values)...);
+    return tree.size() != before;
+}
+
+#endif /* static_rbt_h */
@@ -0,0 +1,593 @@
+#ifndef string_rbt_h
+#define string_rbt_h
+#include "rbt.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __cplusplus < 201703L
+#error "string_rbt.h needs C++17 for std::string_view"
+#endif
+
+/**
+ where a string_rbt keeps the bytes of its keys, in large chunks instead of one heap block per string
+ erased keys leave their bytes behind until compaction copies the live ones into fresh chunks
+ it also keeps the prefix every key in the tree shares, and with shared prefixes on, a table of stems:
+ prefixes ending in '/' that are stored once and referred to by index, such as the scheme and host of a URL
+ */
+class rbt_string_storage
+{
+public:
+    static constexpr size_t chunk_size = 64 * 1024;
+    static constexpr size_t min_stem = 16; // shorter stems save less than their entry in the table costs
+    static constexpr size_t max_stems = 65535; // stem 0 means none
+
+    explicit rbt_string_storage(bool _share_prefixes) : share_prefixes(_share_prefixes) { stems.emplace_back(); }
+
+    /**
+     copy bytes to the end of the arena
+     @param bytes is what to copy
+     @param length is how many bytes
+     @return where they are now, stable until the next compaction
+     */
+    const char* append(const char* bytes, size_t length);
+
+    /**
+     take back the bytes the last append gave out, when the key turned out to be a duplicate
+     @param at is what append returned
+     @param length is how many bytes it copied
+     */
+    void unappend(const char* at, size_t length);
+
+    /**
+     count the bytes of an erased key as garbage
+     @param length is how many bytes it had
+     */
+    void release(size_t length) { dead_bytes += length; live_bytes -= length; }
+
+    /**
+     find the stem of a key: the longest prefix ending in '/' that is already a stem, or else a new stem,
+     the shortest prefix ending in '/' that is at least min_stem long
+     @param key is the whole key
+     @return the stem's index, 0 if the key has none, shared prefixes are off or the table is full
+     */
+    std::uint16_t stem_of(std::string_view key);
+
+    /**
+     @return the bytes of stem i
+     */
+    std::string_view stem(std::uint16_t i) const { return stems[i]; }
+
+    /**
+     @return the prefix every key in the tree starts with
+     */
+    const std::string& common() const { return common_prefix; }
+    size_t common_length() const { return common_size; }
+
+    /**
+     set the prefix every key starts with, to a whole key when it is the only one or shorter as keys that differ come in
+     @param prefix is the new prefix
+     */
+    void set_common(std::string_view prefix) { common_prefix.assign(prefix.data(), prefix.size()); common_size = prefix.size(); }
+
+    /**
+     @return true if garbage outweighs the live bytes and is worth a pass to reclaim
+     */
+    bool worth_compacting() const { return dead_bytes > live_bytes && dead_bytes > chunk_size; }
+
+    /**
+     @return the bytes held by chunks and stems
+     */
+    size_t bytes() const { return chunk_bytes + stem_bytes; }
+
+    /**
+     free every chunk and take over the chunks of another storage, after compaction copied the live bytes into it
+     @param fresh is the storage the live bytes were copied into
+     */
+    void take_chunks(rbt_string_storage& fresh);
+
+    const bool share_prefixes;
+
+private:
+    std::vector< std::unique_ptr<char[]> > chunks;
+    char* cursor = nullptr; // the next free byte of the chunk being filled
+    size_t room = 0; // bytes left after cursor
+    size_t chunk_bytes = 0;
+    size_t live_bytes = 0;
+    size_t dead_bytes = 0;
+    std::string common_prefix;
+    size_t common_size = 0; // the length of common_prefix, read by every comparison
+    std::deque<std::string> stem_text; // never moves its strings, so the views in stems stay valid
+    std::vector<std::string_view> stems;
+    std::unordered_map<std::string_view, std::uint16_t> stem_index;
+    size_t stem_bytes = 0;
+};
+
+/**
+ the value a string_rbt keeps in each rbt node in place of a std::string: 24 bytes, with the key bytes in the arena
+ head holds the 8 bytes of the key right after the prefix all keys share, as a big-endian integer, zero padded,
+ so two keys whose heads differ are ordered by one integer comparison without touching the arena
+ a key with a stem keeps only the bytes after the stem in the arena
+ */
+struct rbt_string_key
+{
+    mutable std::uint64_t head; // mutable so it can be worked out again when the shared prefix shrinks, which keeps the order
+    mutable const char* tail; // mutable so compaction can move the bytes, which never changes the order
+    std::uint32_t tail_length;
+    std::uint16_t stem;
+};
+
+/**
+ a key to search for, which starts with the shared prefix, with its head worked out once instead of at every level
+ */
+struct rbt_string_probe
+{
+    std::uint64_t head;
+    std::string_view text;
+};
+
+/**
+ the comparator of a string_rbt: heads first, then the rest of the keys past the bytes the heads and stems already settled
+ transparent, so the tree is searched with an rbt_string_probe and never builds a key to look one up
+ */
+class rbt_string_compare
+{
+public:
+    /**
+     a key as up to two runs of bytes, its stem and its tail
+     */
+    struct pieces
+    {
+        const char* first;
+        size_t first_length;
+        const char* second;
+        size_t second_length;
+        size_t size() const { return first_length + second_length; }
+        void skip(size_t n)
+        {
+            const size_t from_first = n < first_length ? n : first_length;
+            first += from_first;
+            first_length -= from_first;
+            second += n - from_first;
+            second_length -= n - from_first;
+        }
+    };
+
+private:
+    const rbt_string_storage* storage = nullptr;
+
+    pieces split(const rbt_string_key& key) const
+    {
+        if (key.stem == 0) { return pieces{ key.tail, key.tail_length, nullptr, 0 }; } // no trip to the stem table
+        const std::string_view stem = storage->stem(key.stem);
+        return pieces{ stem.data(), stem.size(), key.tail, key.tail_length };
+    }
+    pieces split(const rbt_string_probe& probe) const { return pieces{ probe.text.data(), probe.text.size(), nullptr, 0 }; }
+
+    static std::uint16_t stem_of(const rbt_string_key& key) { return key.stem; }
+    static std::uint16_t stem_of(const rbt_string_probe&) { return 0; }
+
+    template< typename A, typename B >
+    int order(const A& a, const B& b) const
+    {
+        if (a.head != b.head) { return a.head < b.head ? -1 : 1; }
+        pieces x = split(a), y = split(b);
+        // equal heads mean the shared prefix and the next 8 bytes match, as far as the shorter key goes; so does a shared stem
+        size_t known = storage->common_length() + 8;
+        if (known > x.size()) { known = x.size(); }
+        if (known > y.size()) { known = y.size(); }
+        if (stem_of(a) != 0 && stem_of(a) == stem_of(b) && x.first_length > known) { known = x.first_length; }
+        x.skip(known);
+        y.skip(known);
+        return compare_pieces(x, y);
+    }
+
+public:
+    using is_transparent = void;
+
+    rbt_string_compare() = default;
+    explicit rbt_string_compare(const rbt_string_storage* _storage) : storage(_storage) { }
+
+    /**
+     8 bytes of a key from offset on, as a big-endian integer, zero padded
+     @param key is the key
+     @param offset is where to start
+     @return its head
+     */
+    static std::uint64_t head_of(pieces key, size_t offset);
+    static std::uint64_t head_of(std::string_view key, size_t offset) { return head_of(pieces{ key.data(), key.size(), nullptr, 0 }, offset); }
+
+    /**
+     lexicographic comparison of two keys given in pieces
+     @return -1, 0 or 1 as a is smaller, equal or larger
+     */
+    static int compare_pieces(pieces a, pieces b);
+
+    /**
+     @return a key as pieces, its stem and its tail
+     */
+    pieces pieces_of(const rbt_string_key& key) const { return split(key); }
+
+    /**
+     compare two keys in one step, which lets rbt walk down with one comparison per level (see rbt_three_way)
+     @return -1 if a goes before b, 1 if it goes after, 0 if they are equal
+     */
+    int compare(const rbt_string_key& a, const rbt_string_key& b) const { return order(a, b); }
+
+    bool operator()(const rbt_string_key& a, const rbt_string_key& b) const { return order(a, b) < 0; }
+    bool operator()(const rbt_string_key& a, const rbt_string_probe& b) const { return order(a, b) < 0; }
+    bool operator()(const rbt_string_probe& a, const rbt_string_key& b) const { return order(a, b) < 0; }
+};
+
+/**
+ an ordered set of strings built on rbt, for keys such as URLs or paths where rbt<std::string> spends a std::string in every node
+ and a second heap block for every key past the small-string limit
+ each node holds a 24-byte rbt_string_key: 8 bytes of the key inline, which settle most comparisons, and a pointer to the rest
+ in a per-tree arena of 64 KiB chunks; lookups take a std::string_view and build nothing
+ the inline bytes are the ones right after the prefix every key shares (such as "https://www."), since those would never differ;
+ when a key comes in that does not share the whole prefix, it shrinks and every head is worked out again in one O(n) pass,
+ which happens at most once per byte of the first key and in practice only for the first few keys
+ with share_prefixes, keys also keep a prefix ending in '/', such as a URL's scheme and host, once in a table of stems,
+ so keys under the same stem store only what follows it
+ iterating gives each key as a new std::string, or appends it to a string the caller reuses with append_to
+ @tparam balance_policy is rbt_red_black (the default), rbt_avl or rbt_wavl
+*/
+template< typename balance_policy = rbt_red_black >
+class string_rbt
+{
+private:
+    std::unique_ptr<rbt_string_storage> storage; // on the heap, so the tree's comparator can point at it across moves
+    using tree_type = rbt<rbt_string_key, rbt_string_compare, rbt_no_stats, balance_policy>;
+    tree_type tree;
+
+    /**
+     make a probe for a key
+     @param key is the key
+     @param probe is set to the probe if the key starts with the shared prefix
+     @return the order of the key's start against the shared prefix: 0 if it starts with it, -1 if it is smaller, 1 if larger
+     */
+    int make_probe(std::string_view key, rbt_string_probe& probe) const;
+
+    /**
+     shrink the shared prefix to what it has in common with a new key, and work out every head again if it changed
+     @param key is the key about to be inserted
+     */
+    void share_prefix_with(std::string_view key);
+
+    /**
+     copy the live key bytes into fresh chunks in sorted order and free the old ones
+     */
+    void compact_now();
+
+public:
+    /**
+     the iterator of a string_rbt, in increasing order
+     */
+    class const_iterator
+    {
+        friend string_rbt;
+    private:
+        typename tree_type::const_iterator at;
+        const rbt_string_storage* storage = nullptr;
+        const_iterator(typename tree_type::const_iterator _at, const rbt_string_storage* _storage) : at(_at), storage(_storage) { }
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::string;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string;
+
+        const_iterator() = default;
+
+        /**
+         @return the key, put together from its stem and tail
+         */
+        std::string operator*() const
+        {
+            std::string key;
+            append_to(key);
+            return key;
+        }
+
+        /**
+         add the key to the end of a string, which allocates nothing once the string has the room
+         @param out is the string to add to
+         */
+        void append_to(std::string& out) const
+        {
+            const std::string_view stem = storage->stem(at->stem);
+            out.append(stem.data(), stem.size());
+            out.append(at->tail, at->tail_length);
+        }
+
+        /**
+         @return the length of the key
+         */
+        size_t length() const { return storage->stem(at->stem).size() + at->tail_length; }
+
+        const_iterator& operator++() { ++at; return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++at; return copy; }
+        const_iterator& operator--() { --at; return *this; }
+        const_iterator operator--(int) { const_iterator copy(*this); --at; return copy; }
+        bool operator==(const const_iterator& other) const { return at == other.at; }
+        bool operator!=(const const_iterator& other) const { return at != other.at; }
+    };
+    using iterator = const_iterator;
+
+    /**
+     constructor, an empty set
+     @param share_prefixes is whether keys keep a shared prefix ending in '/' in a table of stems
+     */
+    explicit string_rbt(bool share_prefixes = false)
+        : storage(new rbt_string_storage(share_prefixes)), tree(rbt_string_compare(storage.get())) { }
+
+    string_rbt(const string_rbt&) = delete;
+    string_rbt& operator=(const string_rbt&) = delete;
+
+    /**
+     move constructor, the other set is left empty and usable
+     @param other is the set to take the keys of
+     */
+    string_rbt(string_rbt&& other) : string_rbt(other.storage->share_prefixes) { swap(other); }
+
+    /**
+     move assignment, swaps the keys so the old ones go away with other
+     @param other is the set to take the keys of
+     @return this set
+     */
+    string_rbt& operator=(string_rbt&& other) { swap(other); return *this; }
+
+    /**
+     insert a copy of a key, its bytes go to the arena
+     @param key is the key to insert, at most 4 GiB long
+     @return true if it was inserted, false if it was already there
+     */
+    bool insert(std::string_view key);
+
+    /**
+     erase a key, its bytes stay in the arena until enough garbage builds up to compact it
+     @param key is the key to remove
+     @return the number of keys removed, 0 or 1
+     */
+    size_t erase(std::string_view key);
+
+    /**
+     locate a key
+     @param key is the key to look for
+     @return its iterator, or end() if not found
+     */
+    const_iterator find(std::string_view key) const;
+
+    /**
+     find the first key not smaller than the given one
+     @param key is the key to look for
+     @return its iterator, or end() if every key is smaller
+     */
+    const_iterator lower_bound(std::string_view key) const;
+
+    const_iterator begin() const { return const_iterator(tree.begin(), storage.get()); }
+    const_iterator end() const { return const_iterator(tree.end(), storage.get()); }
+
+    /**
+     @return the number of keys
+     */
+    size_t size() const { return tree.size(); }
+
+    /**
+     @return true if there are no keys
+     */
+    bool empty() const { return tree.size() == 0; }
+
+    /**
+     @return the bytes held by the arena and the stem table, the nodes not counted
+     */
+    size_t arena_bytes() const { return storage->bytes(); }
+
+    /**
+     copy the live key bytes into fresh, tightly packed chunks now, instead of waiting for erased keys to outweigh them
+     */
+    void compact() { compact_now(); }
+
+    /**
+     swap the keys of two sets, O(1)
+     @param other is the set to swap with
+     */
+    void swap(string_rbt& other)
+    {
+        storage.swap(other.storage);
+        tree.swap(other.tree); // the comparators go with the trees, so each still points at its own storage
+    }
+
+    /**
+     Check every invariant of the tree
+     @return true if the tree is valid
+     */
+    bool validate() const { return tree.validate(); }
+};
+
+/**
+ non-member swap function for string_rbt
+ @param set1 is the "left hand side" string_rbt
+ @param set2 is the "right hand side" string_rbt
+*/
+template< typename balance_policy >
+void swap(string_rbt<balance_policy>& set1, string_rbt<balance_policy>& set2) { set1.swap(set2); }
+
+inline const char* rbt_string_storage::append(const char* bytes, size_t length)
+{
+    live_bytes += length;
+    if (length > chunk_size / 4) // a large key gets a chunk of its own, so it does not waste the rest of the current one
+    {
+        chunks.emplace_back(new char[length]);
+        chunk_bytes += length;
+        std::memcpy(chunks.back().get(), bytes, length);
+        return chunks.back().get();
+    }
+    if (length > room) // bump allocation goes on in a new chunk
+    {
+        chunks.emplace_back(new char[chunk_size]);
+        chunk_bytes += chunk_size;
+        cursor = chunks.back().get();
+        room = chunk_size;
+    }
+    char* at = cursor;
+    if (length != 0) { std::memcpy(at, bytes, length); }
+    cursor += length;
+    room -= length;
+    return at;
+}
+
+inline void rbt_string_storage::unappend(const char* at, size_t length)
+{
+    live_bytes -= length;
+    if (length != 0 && at + length == cursor) { cursor -= length; room += length; } // the last bytes handed out, give them back
+    else { dead_bytes += length; } // a large key's own chunk, left as garbage
+}
+
+inline std::uint16_t rbt_string_storage::stem_of(std::string_view key)
+{
+    if (!share_prefixes || key.size() < min_stem) { return 0; }
+    // the longest stem already known, found from the last '/' back
+    for (size_t slash = key.rfind('/'); slash != std::string_view::npos && slash + 1 >= min_stem; slash = key.rfind('/', slash - 1))
+    {
+        const auto found = stem_index.find(key.substr(0, slash + 1));
+        if (found != stem_index.end()) { return found->second; }
+    }
+    const size_t slash = key.find('/', min_stem - 1);
+    if (slash == std::string_view::npos || stems.size() > max_stems) { return 0; } // no stem, or the table is full
+    const std::string_view stem = key.substr(0, slash + 1);
+    stem_text.emplace_back(stem);
+    stems.emplace_back(stem_text.back());
+    stem_bytes += stem.size();
+    const std::uint16_t i = static_cast<std::uint16_t>(stems.size() - 1);
+    stem_index.emplace(stems.back(), i);
+    return i;
+}
+
+inline void rbt_string_storage::take_chunks(rbt_string_storage& fresh)
+{
+    chunks.swap(fresh.chunks);
+    std::swap(cursor, fresh.cursor);
+    std::swap(room, fresh.room);
+    std::swap(chunk_bytes, fresh.chunk_bytes);
+    live_bytes = fresh.live_bytes;
+    dead_bytes = 0;
+}
+
+inline std::uint64_t rbt_string_compare::head_of(pieces key, size_t offset)
+{
+    key.skip(offset < key.size() ? offset : key.size());
+    std::uint64_t head = 0;
+    for (unsigned i = 0; i < 8 && key.size() != 0; ++i)
+    {
+        if (key.first_length == 0) { key.first = key.second; key.first_length = key.second_length; key.second_length = 0; }
+        head |= std::uint64_t(static_cast<unsigned char>(*key.first)) << (56 - 8 * i);
+        key.skip(1);
+    }
+    return head;
+}
+
+inline int rbt_string_compare::compare_pieces(pieces a, pieces b)
+{
+    // lexicographic order of the concatenations, one memcmp per overlapping run
+    while (true)
+    {
+        if (a.first_length == 0) { a.first = a.second; a.first_length = a.second_length; a.second_length = 0; }
+        if (b.first_length == 0) { b.first = b.second; b.first_length = b.second_length; b.second_length = 0; }
+        const size_t n = a.first_length < b.first_length ? a.first_length : b.first_length;
+        if (n == 0) { break; } // one of them ran out
+        const int r = std::memcmp(a.first, b.first, n);
+        if (r != 0) { return r < 0 ? -1 : 1; }
+        a.skip(n);
+        b.skip(n);
+    }
+    return (a.size() > b.size()) - (a.size() < b.size()); // the shorter one is a prefix of the other
+}
+
+template< typename balance_policy >
+int string_rbt<balance_policy>::make_probe(std::string_view key, rbt_string_probe& probe) const
+{
+    const std::string& common = storage->common();
+    const int start = key.substr(0, common.size()).compare(common); // a key shorter than the prefix comes before every key
+    if (start != 0) { return start < 0 ? -1 : 1; }
+    probe = rbt_string_probe{ rbt_string_compare::head_of(key, common.size()), key };
+    return 0;
+}
+
+template< typename balance_policy >
+void string_rbt<balance_policy>::share_prefix_with(std::string_view key)
+{
+    if (tree.size() == 0) { storage->set_common(key); return; } // a lone key shares all of itself
+    const std::string& common = storage->common();
+    size_t shared = 0;
+    while (shared < common.size() && shared < key.size() && common[shared] == key[shared]) { ++shared; }
+    if (shared == common.size()) { return; }
+    storage->set_common(key.substr(0, shared));
+    const rbt_string_compare& pred = rbt_string_compare(storage.get());
+    for (auto iter = tree.begin(); iter != tree.end(); ++iter) { iter->head = pred.head_of(pred.pieces_of(*iter), shared); }
+}
+
+template< typename balance_policy >
+bool string_rbt<balance_policy>::insert(std::string_view key)
+{
+    share_prefix_with(key);
+    const std::uint16_t stem = storage->stem_of(key);
+    const size_t skip = storage->stem(stem).size();
+    const size_t length = key.size() - skip;
+    const char* tail = storage->append(key.data() + skip, length);
+    const size_t before = tree.size();
+    tree.insert(rbt_string_key{ rbt_string_compare::head_of(key, storage->common().size()), tail, static_cast<std::uint32_t>(length), stem });
+    if (tree.size() != before) { return true; }
+    storage->unappend(tail, length); // a duplicate, one walk down the tree found it and the bytes go back
+    return false;
+}
+
+template< typename balance_policy >
+size_t string_rbt<balance_policy>::erase(std::string_view key)
+{
+    rbt_string_probe probe;
+    if (make_probe(key, probe) != 0) { return 0; } // it does not share the prefix, so it is not here
+    const auto found = tree.find(probe);
+    if (found == tree.end()) { return 0; }
+    storage->release(found->tail_length);
+    tree.erase(found);
+    if (storage->worth_compacting()) { compact_now(); }
+    return 1;
+}
+
+template< typename balance_policy >
+typename string_rbt<balance_policy>::const_iterator string_rbt<balance_policy>::find(std::string_view key) const
+{
+    rbt_string_probe probe;
+    if (make_probe(key, probe) != 0) { return end(); }
+    return const_iterator(tree.find(probe), storage.get());
+}
+
+template< typename balance_policy >
+typename string_rbt<balance_policy>::const_iterator string_rbt<balance_policy>::lower_bound(std::string_view key) const
+{
+    rbt_string_probe probe;
+    const int start = make_probe(key, probe);
+    if (start != 0) { return start < 0 ? begin() : end(); } // smaller or larger than every key
+    return const_iterator(tree.lower_bound(probe), storage.get());
+}
+
+template< typename balance_policy >
+void string_rbt<balance_policy>::compact_now()
+{
+    rbt_string_storage fresh(false);
+    for (auto iter = tree.begin(); iter != tree.end(); ++iter)
+    {
+        iter->tail = fresh.append(iter->tail, iter->tail_length); // in sorted order, so neighbours end up next to each other
+    }
+    storage->take_chunks(fresh);
+}
+
+#endif /* string_rbt_h */